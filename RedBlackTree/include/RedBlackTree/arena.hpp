@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Trees::RBT {
+
+// Fixed-size slot pool: hands out slots from large contiguous chunks and keeps
+// erased slots in an intrusive free list. All memory is returned when the pool dies,
+// except chunks another pool has adopted, which live until that pool dies too.
+class Arena
+{
+public:
+    Arena(std::size_t slot_size, std::size_t slot_align)
+        : slot_size_ (RoundUp_(std::max(slot_size, sizeof(FreeSlot)), std::max(slot_align, alignof(FreeSlot))))
+        , slot_align_(std::max(slot_align, alignof(FreeSlot)))
+    {}
+
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate()
+    {
+        if (free_list_)
+        {
+            FreeSlot* slot = free_list_;
+            free_list_ = slot->next;
+            return slot;
+        }
+
+        if (chunks_.empty() || chunks_.back().used == chunks_.back().capacity)
+            AddChunk_();
+
+        Chunk& chunk = chunks_.back();
+
+        return static_cast<std::byte*>(chunk.memory.get()) + slot_size_ * chunk.used++;
+    }
+
+    void Deallocate(void* slot_ptr)
+    {
+        FreeSlot* slot = ::new (slot_ptr) FreeSlot{free_list_};
+        free_list_ = slot;
+    }
+
+    // keeps other's memory alive as long as this pool, so slots handed out by other may be
+    // released here; they join this pool's free list. Both pools must have the same layout.
+    void Adopt(const Arena& other)
+    {
+        if (&other == this)
+            return;
+
+        for (const Chunk& chunk : other.chunks_)
+            adopted_.push_back(chunk.memory);
+
+        adopted_.insert(adopted_.end(), other.adopted_.begin(), other.adopted_.end());
+
+        std::sort(adopted_.begin(), adopted_.end());
+        adopted_.erase(std::unique(adopted_.begin(), adopted_.end()), adopted_.end());
+    }
+
+    std::size_t SlotSize () const { return slot_size_;  }
+    std::size_t SlotAlign() const { return slot_align_; }
+
+    std::size_t ReservedBytes() const
+    {
+        std::size_t bytes = 0;
+
+        for (const Chunk& chunk : chunks_)
+            bytes += chunk.capacity * slot_size_;
+
+        return bytes;
+    }
+
+private:
+    struct FreeSlot { FreeSlot* next; };
+
+    struct Chunk
+    {
+        std::shared_ptr<void> memory;
+        std::size_t           capacity;
+        std::size_t           used;
+    };
+
+    static constexpr std::size_t FIRST_CHUNK_SLOTS = 256;
+    static constexpr std::size_t MAX_CHUNK_SLOTS   = 1 << 16;
+
+    std::size_t slot_size_;
+    std::size_t slot_align_;
+
+    std::vector<Chunk>                  chunks_    = {};
+    std::vector<std::shared_ptr<void>>  adopted_   = {};    // chunks of other pools
+    FreeSlot*                           free_list_ = nullptr;
+
+    static std::size_t RoundUp_(std::size_t value, std::size_t align) { return (value + align - 1) / align * align; }
+
+    void AddChunk_()
+    {
+        std::size_t capacity = chunks_.empty() ? FIRST_CHUNK_SLOTS
+                                               : std::min(chunks_.back().capacity * 2, MAX_CHUNK_SLOTS);
+
+        std::align_val_t align = std::align_val_t(slot_align_);
+
+        std::shared_ptr<void> memory(::operator new(capacity * slot_size_, align),
+                                     [align](void* chunk) { ::operator delete(chunk, align); });
+
+        chunks_.push_back({std::move(memory), capacity, 0});
+    }
+};
+
+
+// Standard allocator over a shared Arena. Copies share the arena, so memory allocated
+// through one copy may be released through another. Rebinding to a type with another
+// slot layout starts a new arena. Requests for more than one object go to operator new.
+template <typename T>
+class ArenaAllocator
+{
+    template <typename U>
+    friend class ArenaAllocator;
+
+public:
+    using value_type                             = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    ArenaAllocator()
+        : arena_(std::make_shared<Arena>(sizeof(T), alignof(T)))
+    {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : arena_(SameLayout_(*other.arena_) ? other.arena_ : std::make_shared<Arena>(sizeof(T), alignof(T)))
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        if (n == 1)
+            return static_cast<T*>(arena_->Allocate());
+
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    void deallocate(T* ptr, std::size_t n)
+    {
+        if (n == 1)
+            arena_->Deallocate(ptr);
+
+        else
+            ::operator delete(ptr, std::align_val_t(alignof(T)));
+    }
+
+    ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+
+    std::size_t ReservedBytes() const { return arena_->ReservedBytes(); }
+
+    // true while other copies use the same arena, so it will not be released with this one
+    bool        IsShared() const { return arena_.use_count() > 1; }
+
+    // lets this allocator release objects allocated by other, see Arena::Adopt
+    void Adopt(const ArenaAllocator& other)
+    {
+        if (arena_ != other.arena_)
+            arena_->Adopt(*other.arena_);
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena_; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena_; }
+
+private:
+    std::shared_ptr<Arena> arena_;
+
+    static bool SameLayout_(const Arena& arena)
+    {
+        Arena probe_layout(sizeof(T), alignof(T));
+
+        return arena.SlotSize() == probe_layout.SlotSize() && arena.SlotAlign() == probe_layout.SlotAlign();
+    }
+};
+
+
+// Allocators whose memory is reclaimed in one go when the last copy dies.
+// Trees with trivially destructible keys skip the per-node teardown for them
+// when IsShared() says that their copy is the last one.
+template <typename Alloc>
+inline constexpr bool releases_in_bulk_v = false;
+
+template <typename T>
+inline constexpr bool releases_in_bulk_v<ArenaAllocator<T>> = true;
+
+}
@@ -0,0 +1,1133 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "RLogSU/graph_appearance.hpp"
+#include "RLogSU/graph.hpp"
+#include "RedBlackTree/trace.hpp"
+#include "RedBlackTree/tree.hpp"
+
+namespace Trees::RBT {
+
+// Red-black tree with the interface of Tree, but with nodes stored in one contiguous
+// array and linked by 32-bit indices. Index 0 is the nil sentinel and the color lives in
+// the top bit of the father index, so an int node takes 20 bytes instead of 40 and the
+// upper levels of a large tree stay in fewer cache lines. Iterators hold indices, so they
+// survive the array growth. Everything that relinks whole subtrees of Tree (Split, Join,
+// the set operations, range erase) and the batched lookups have no counterpart here.
+
+template <typename KeyT, typename Comp>
+class CompactTree;
+
+template <typename TreeKeyT, typename TreeComp, typename IteratorKeyT>
+class CompactIterator
+{
+    friend class CompactTree<TreeKeyT, TreeComp>;
+
+    template<typename A, typename B, typename C>
+    friend class CompactIterator;
+
+    using Tree  = CompactTree<TreeKeyT, TreeComp>;
+    using TreeP = std::conditional_t<std::is_const_v<IteratorKeyT>, const Tree*, Tree*>;
+    using Index = std::uint32_t;
+
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = std::remove_const_t<IteratorKeyT>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = IteratorKeyT*;
+    using reference         = IteratorKeyT&;
+
+    CompactIterator() = default;
+
+    // iterator converts to const_iterator
+    template <typename OtherKeyT>
+    requires (std::is_const_v<IteratorKeyT> && std::is_same_v<OtherKeyT, std::remove_const_t<IteratorKeyT>>)
+    CompactIterator(const CompactIterator<TreeKeyT, TreeComp, OtherKeyT>& other)
+    : tree_(other.tree_)
+    , node_idx_(other.node_idx_)
+    {}
+
+private:
+    explicit CompactIterator(TreeP tree, Index node_idx)
+    : tree_(tree)
+    , node_idx_(node_idx)
+    {}
+
+public:
+    IteratorKeyT& operator*()  const { return tree_->nodes_[node_idx_].key; }
+    IteratorKeyT* operator->() const { return &tree_->nodes_[node_idx_].key; }
+
+    Index get() const { return node_idx_; }
+
+    CompactIterator& operator++()
+    {
+        node_idx_ = tree_->Next_(node_idx_);
+        return *this;
+    }
+
+    CompactIterator operator++(int)
+    {
+        CompactIterator temp = *this;
+        ++(*this);
+        return temp;
+    }
+
+    // --end() is the maximum
+    CompactIterator& operator--()
+    {
+        node_idx_ = tree_->Prev_(node_idx_);
+        return *this;
+    }
+
+    CompactIterator operator--(int)
+    {
+        CompactIterator temp = *this;
+        --(*this);
+        return temp;
+    }
+
+    bool operator==(const CompactIterator& other) const { return node_idx_ == other.node_idx_; }
+    bool operator!=(const CompactIterator& other) const { return node_idx_ != other.node_idx_; }
+
+private:
+    TreeP tree_     = nullptr;
+    Index node_idx_ = 0;
+};
+
+
+template <typename KeyT, typename Comp>
+class CompactTree
+{
+public:
+    typedef CompactIterator<KeyT, Comp, KeyT>       iterator;
+    typedef CompactIterator<KeyT, Comp, const KeyT> const_iterator;
+
+    typedef std::reverse_iterator<iterator>         reverse_iterator;
+    typedef std::reverse_iterator<const_iterator>   const_reverse_iterator;
+
+    friend iterator;
+    friend const_iterator;
+
+    CompactTree();
+
+    template <std::input_iterator InputIt>
+    CompactTree(InputIt first, InputIt last) : CompactTree() { BulkLoad(first, last); }
+
+    iterator       begin()       { return CreateIterator (BeginNode_()); };
+    const_iterator begin() const { return CreateIterator (BeginNode_()); };
+
+    iterator       end  ()       { return CreateIterator (NIL); }
+    const_iterator end  () const { return CreateIterator (NIL); }
+
+    reverse_iterator       rbegin()       { return reverse_iterator      (end()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+
+    reverse_iterator       rend  ()       { return reverse_iterator      (begin()); }
+    const_reverse_iterator rend  () const { return const_reverse_iterator(begin()); }
+
+    // minimum and maximum keys, the tree must not be empty
+    const KeyT&    front() const { RBT_ASSERT(root_ != NIL); return nodes_[GetMin_(root_)].key; }
+    const KeyT&    back () const { RBT_ASSERT(root_ != NIL); return nodes_[GetMax_(root_)].key; }
+
+    iterator       find(const KeyT& key)       { return CreateIterator (FindInSubtree_(root_, key)); };
+    const_iterator find(const KeyT& key) const { return CreateIterator (FindInSubtree_(root_, key)); };
+
+    template <typename K> requires TransparentComparator<Comp>
+    iterator       find(const K& key)          { return CreateIterator (FindInSubtree_(root_, key)); };
+    template <typename K> requires TransparentComparator<Comp>
+    const_iterator find(const K& key) const    { return CreateIterator (FindInSubtree_(root_, key)); };
+
+    iterator       insert(const KeyT& new_key);
+
+    // hint is the element that should follow new_key, a right hint skips the descent, a wrong one costs a full one
+    iterator       insert(const_iterator hint, const KeyT& new_key);
+
+    // sorts the batch, so consecutive descents share their upper levels; returns the number of new keys
+    std::size_t    InsertBatch(std::span<const KeyT> batch);
+
+    void           erase(iterator erase_it)     { DeleteNode_(erase_it.node_idx_); }
+    void           erase(const KeyT& erase_key) { DeleteNode_(FindInSubtree_(root_, erase_key)); }
+
+    // adds [first, last) and rebuilds the array in key order, O(n + m) when the range is sorted and unique
+    template <std::input_iterator InputIt>
+    void           BulkLoad(InputIt first, InputIt last);
+
+    void           clear();
+
+    iterator       LowerBound(const KeyT& key)       { return CreateIterator (LowerBoundNode_(key)); }   // first not less then key
+    iterator       UpperBound(const KeyT& key)       { return CreateIterator (UpperBoundNode_(key)); }   // first greater  then key
+    const_iterator LowerBound(const KeyT& key) const { return CreateIterator (LowerBoundNode_(key)); }
+    const_iterator UpperBound(const KeyT& key) const { return CreateIterator (UpperBoundNode_(key)); }
+
+    template <typename K> requires TransparentComparator<Comp>
+    iterator       LowerBound(const K& key)          { return CreateIterator (LowerBoundNode_(key)); }
+    template <typename K> requires TransparentComparator<Comp>
+    iterator       UpperBound(const K& key)          { return CreateIterator (UpperBoundNode_(key)); }
+    template <typename K> requires TransparentComparator<Comp>
+    const_iterator LowerBound(const K& key) const    { return CreateIterator (LowerBoundNode_(key)); }
+    template <typename K> requires TransparentComparator<Comp>
+    const_iterator UpperBound(const K& key) const    { return CreateIterator (UpperBoundNode_(key)); }
+
+    std::size_t    size () const { return nodes_[root_].size; }
+    bool           empty() const { return root_ == NIL; }
+
+    Comp           key_comp() const { return comparator_; }
+
+    std::size_t    Rank        (const KeyT& key) const                 { return CountLess_(key); }             // number of keys less then key
+    std::size_t    CountInRange(const KeyT& lo, const KeyT& hi) const  { return CountInRange_(lo, hi); }       // number of keys in [lo, hi]
+
+    template <typename K> requires TransparentComparator<Comp>
+    std::size_t    Rank        (const K& key) const                    { return CountLess_(key); }
+    template <typename K> requires TransparentComparator<Comp>
+    std::size_t    CountInRange(const K& lo, const K& hi) const        { return CountInRange_(lo, hi); }
+
+    iterator       Select(std::size_t k)       { return CreateIterator (SelectNode_(k)); }   // k-th key counting from 0,
+    const_iterator Select(std::size_t k) const { return CreateIterator (SelectNode_(k)); }   // end() if k >= size()
+
+    // calls fn(key) for the keys in [lo, hi] in order
+    template <typename Fn>
+    void           ForEachInRange(const KeyT& lo, const KeyT& hi, Fn&& fn) const;
+
+    void           reserve(std::size_t count) { nodes_.reserve(count + 1); }
+    std::size_t    MemoryBytes() const        { return nodes_.capacity() * sizeof(Node); }
+
+#ifndef NDEBUG
+    void Dump() const;
+#endif
+
+private:
+    // per tree, so a stateful comparator is never shared between trees or threads
+    [[no_unique_address]] Comp comparator_ = {};
+
+    using Index = std::uint32_t;
+
+    static constexpr Index NIL       = 0;
+    static constexpr Index RED_BIT   = Index(1) << 31;
+    static constexpr Index INDEX_MAX = RED_BIT - 1;
+
+    struct Node
+    {
+        KeyT  key;
+        Index left;
+        Index right;
+        Index father_color;     // father index, the top bit is set for red nodes
+        Index size;
+    };
+
+    std::vector<Node> nodes_;
+    Index             root_      = NIL;
+    Index             free_list_ = NIL;     // erased slots chained through left
+
+    Index Left_  (Index node) const { return nodes_[node].left;  }
+    Index Right_ (Index node) const { return nodes_[node].right; }
+    Index Father_(Index node) const { return nodes_[node].father_color & INDEX_MAX; }
+    bool  IsRed_ (Index node) const { return nodes_[node].father_color & RED_BIT; }
+
+    void SetFather_(Index node, Index father) { nodes_[node].father_color = (nodes_[node].father_color & RED_BIT) | father; }
+    void SetRed_   (Index node)               { nodes_[node].father_color |=  RED_BIT; }
+    void SetBlack_ (Index node)               { nodes_[node].father_color &= ~RED_BIT; }
+    void CopyColor_(Index dest, Index src)    { if (IsRed_(src)) SetRed_(dest); else SetBlack_(dest); }
+
+    template <typename L, typename R>
+    bool  Before_(const L& lhs, const R& rhs) const { return comparator_(rhs, lhs); }
+
+    Index CreateNode_ (const KeyT& key, Index father);
+    void  DestroyNode_(Index node);
+
+    Index BeginNode_() const;
+
+    Index GetMin_(Index subtree_root) const;
+    Index GetMax_(Index subtree_root) const;
+    Index Next_  (Index node) const;
+    Index Prev_  (Index node) const;
+    Index Predecessor_(Index node) const;     // Prev_ of a node, NIL for the first one without a warning
+
+    template <typename K>
+    Index FindInSubtree_  (Index sub_root, const K& key) const;
+    template <typename K>
+    Index LowerBoundNode_ (const K& key) const;
+    template <typename K>
+    Index UpperBoundNode_ (const K& key) const;
+    Index SelectNode_     (std::size_t k) const;
+
+    template <typename K>
+    std::size_t CountLess_      (const K& key) const;
+    template <typename K>
+    std::size_t CountNotGreater_(const K& key) const;
+    template <typename K>
+    std::size_t CountInRange_   (const K& lo, const K& hi) const;
+
+    void        UpdateSizesUpward_(Index from);
+
+    // links a new red node under father and rebalances
+    Index LinkNode_    (const KeyT& key, Index father, bool as_left);
+    Index BuildSubtree_(const std::vector<KeyT>& keys, std::size_t first, std::size_t count,
+                        Index father, unsigned depth, unsigned red_depth);
+
+    void Transplant_   (Index replaceable, Index substitute);
+    void LeftRotate_   (Index sub_root);
+    void RightRotate_  (Index sub_root);
+
+    void DeleteNode_   (Index del_node);
+
+    void FixupInsert_(Index inserted);
+    void FixupDelete_(Index fixup_node);
+
+    iterator       CreateIterator (Index idx)       { return iterator       (this, idx); }
+    const_iterator CreateIterator (Index idx) const { return const_iterator (this, idx); }
+};
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::CompactTree()
+    : nodes_(1, Node{KeyT{}, NIL, NIL, NIL, 0})
+{}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::CreateNode_(const KeyT& key, Index father)
+{
+    Index node = free_list_;
+
+    if (node != NIL)
+    {
+        free_list_   = nodes_[node].left;
+        nodes_[node] = Node{key, NIL, NIL, father | RED_BIT, 1};
+    }
+
+    else
+    {
+        // one more node would set RED_BIT in its index
+        if (nodes_.size() > INDEX_MAX)
+            throw std::length_error("CompactTree: more than 2^31 - 1 nodes");
+
+        node = static_cast<Index>(nodes_.size());
+        nodes_.push_back(Node{key, NIL, NIL, father | RED_BIT, 1});
+    }
+
+    return node;
+}
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::DestroyNode_(Index node)
+{
+    nodes_[node].key  = KeyT{};
+    nodes_[node].left = free_list_;
+    free_list_        = node;
+}
+
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::Transplant_(Index replaceable, Index substitute)
+{
+    Index father = Father_(replaceable);
+
+    if (replaceable == root_)
+        root_ = substitute;
+
+    else if (replaceable == Left_(father))
+        nodes_[father].left = substitute;
+
+    else
+        nodes_[father].right = substitute;
+
+    SetFather_(substitute, father);
+}
+
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::LeftRotate_(Index sub_root)
+{
+    RBT_ASSERT(Right_(sub_root) != NIL);
+
+    Index right_son = Right_(sub_root);
+    Index father    = Father_(sub_root);
+
+    nodes_[sub_root].right = Left_(right_son);
+
+    if (Left_(right_son) != NIL)
+        SetFather_(Left_(right_son), sub_root);
+
+    SetFather_(right_son, father);
+
+    if (sub_root == root_)
+        root_ = right_son;
+
+    else if (sub_root == Left_(father))
+        nodes_[father].left = right_son;
+
+    else
+        nodes_[father].right = right_son;
+
+    nodes_[right_son].left = sub_root;
+    SetFather_(sub_root, right_son);
+
+    nodes_[right_son].size = nodes_[sub_root].size;
+    nodes_[sub_root] .size = nodes_[Left_(sub_root)].size + nodes_[Right_(sub_root)].size + 1;
+}
+
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::RightRotate_(Index sub_root)
+{
+    RBT_ASSERT(Left_(sub_root) != NIL);
+
+    Index left_son = Left_(sub_root);
+    Index father   = Father_(sub_root);
+
+    nodes_[sub_root].left = Right_(left_son);
+
+    if (Right_(left_son) != NIL)
+        SetFather_(Right_(left_son), sub_root);
+
+    SetFather_(left_son, father);
+
+    if (sub_root == root_)
+        root_ = left_son;
+
+    else if (sub_root == Right_(father))
+        nodes_[father].right = left_son;
+
+    else
+        nodes_[father].left = left_son;
+
+    nodes_[left_son].right = sub_root;
+    SetFather_(sub_root, left_son);
+
+    nodes_[left_son].size = nodes_[sub_root].size;
+    nodes_[sub_root].size = nodes_[Left_(sub_root)].size + nodes_[Right_(sub_root)].size + 1;
+}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::iterator CompactTree<KeyT, Comp>::insert(const KeyT& new_key)
+{
+    Index future_father = NIL;
+    Index iterator_node = root_;
+    bool  as_left       = false;
+
+    while (iterator_node != NIL)
+    {
+        future_father = iterator_node;
+
+        if (Before_(new_key, nodes_[iterator_node].key))
+        {
+            as_left       = true;
+            iterator_node = Left_(iterator_node);
+        }
+
+        else if (Before_(nodes_[iterator_node].key, new_key))
+        {
+            as_left       = false;
+            iterator_node = Right_(iterator_node);
+        }
+
+        else
+            return CreateIterator(iterator_node);
+    }
+
+    return CreateIterator(LinkNode_(new_key, future_father, as_left));
+}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::iterator CompactTree<KeyT, Comp>::insert(const_iterator hint, const KeyT& new_key)
+{
+    Index next = hint.node_idx_;
+    // a begin() hint has no predecessor, which is not an error here
+    Index prev = (next == NIL) ? (root_ == NIL ? NIL : GetMax_(root_)) : Predecessor_(next);
+
+    bool fits = (prev == NIL || Before_(nodes_[prev].key, new_key)) &&
+                (next == NIL || Before_(new_key, nodes_[next].key));
+
+    if (!fits || root_ == NIL)
+        return insert(new_key);
+
+    // prev and next are neighbours, so one of the two free slots between them exists
+    if (next != NIL && Left_(next) == NIL)
+        return CreateIterator(LinkNode_(new_key, next, true));
+
+    return CreateIterator(LinkNode_(new_key, prev, false));
+}
+
+
+template <typename KeyT, typename Comp>
+std::size_t CompactTree<KeyT, Comp>::InsertBatch(std::span<const KeyT> batch)
+{
+    std::vector<KeyT> keys(batch.begin(), batch.end());
+
+    std::sort(keys.begin(), keys.end(), [this](const KeyT& lhs, const KeyT& rhs) { return Before_(lhs, rhs); });
+
+    std::size_t old_size = size();
+
+    for (const KeyT& key : keys)
+        insert(key);
+
+    return size() - old_size;
+}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::LinkNode_(const KeyT& key, Index father, bool as_left)
+{
+    Index new_node = CreateNode_(key, father);
+
+    if (father == NIL)
+        root_ = new_node;
+
+    else if (as_left)
+        nodes_[father].left = new_node;
+
+    else
+        nodes_[father].right = new_node;
+
+    UpdateSizesUpward_(father);
+
+    RBT_HANDLE(FixupInsert_(new_node));
+
+    return new_node;
+}
+
+
+template <typename KeyT, typename Comp>
+template <std::input_iterator InputIt>
+void CompactTree<KeyT, Comp>::BulkLoad(InputIt first, InputIt last)
+{
+    auto before = [this](const KeyT& lhs, const KeyT& rhs) { return Before_(lhs, rhs); };
+
+    std::vector<KeyT> keys(first, last);
+
+    bool strictly_sorted = std::adjacent_find(keys.begin(), keys.end(),
+                                              [&](const KeyT& lhs, const KeyT& rhs) { return !before(lhs, rhs); }) == keys.end();
+
+    if (!strictly_sorted)
+    {
+        std::sort(keys.begin(), keys.end(), before);
+        keys.erase(std::unique(keys.begin(), keys.end(), [&](const KeyT& lhs, const KeyT& rhs) { return !before(lhs, rhs); }),
+                   keys.end());
+    }
+
+    if (root_ != NIL)
+    {
+        std::vector<KeyT> merged;
+        merged.reserve(size() + keys.size());
+
+        // keys already in the tree win over equal loaded ones
+        std::set_union(begin(), end(), keys.begin(), keys.end(), std::back_inserter(merged), before);
+
+        keys.swap(merged);
+    }
+
+    clear();
+
+    if (keys.empty())
+        return;
+
+    // the rebuilt array is in key order, so in-order walks and scans read it front to back
+    nodes_.reserve(keys.size() + 1);
+
+    // all levels above the deepest one are full, painting the deepest one red keeps black heights equal
+    unsigned red_depth = static_cast<unsigned>(std::bit_width(keys.size()) - 1);
+
+    root_ = BuildSubtree_(keys, 0, keys.size(), NIL, 0, red_depth);
+    SetBlack_(root_);
+}
+
+
+// builds the subtree of keys[first, first + count): the left half first, so indices follow key order
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::BuildSubtree_(const std::vector<KeyT>& keys, std::size_t first, std::size_t count,
+                                                                      Index father, unsigned depth, unsigned red_depth)
+{
+    if (count == 0)
+        return NIL;
+
+    std::size_t middle = count / 2;
+
+    Index left     = BuildSubtree_(keys, first, middle, NIL, depth + 1, red_depth);
+    Index sub_root = CreateNode_(keys[first + middle], father);
+    Index right    = BuildSubtree_(keys, first + middle + 1, count - middle - 1, sub_root, depth + 1, red_depth);
+
+    if (depth != red_depth)
+        SetBlack_(sub_root);
+
+    nodes_[sub_root].left  = left;
+    nodes_[sub_root].right = right;
+    nodes_[sub_root].size  = static_cast<Index>(count);
+
+    if (left != NIL)
+        SetFather_(left, sub_root);
+
+    return sub_root;
+}
+
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::clear()
+{
+    nodes_.resize(1);
+    root_      = NIL;
+    free_list_ = NIL;
+}
+
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::FixupInsert_(Index inserted)
+{
+    Index cur_node = inserted;
+
+    while (IsRed_(Father_(cur_node)))
+    {
+        Index father  = Father_(cur_node);
+        Index grandpa = Father_(father);
+
+        if (father == Left_(grandpa))
+        {
+            Index uncle = Right_(grandpa);
+
+            if (IsRed_(uncle))
+            {
+                SetBlack_(father);
+                SetBlack_(uncle);
+                SetRed_  (grandpa);
+
+                cur_node = grandpa;
+            }
+
+            else if (cur_node == Right_(father))
+            {
+                cur_node = father;
+                RBT_HANDLE(LeftRotate_(cur_node));
+            }
+
+            else
+            {
+                SetBlack_(father);
+                SetRed_  (grandpa);
+
+                RBT_HANDLE(RightRotate_(grandpa));
+            }
+        }
+
+        else
+        {
+            Index uncle = Left_(grandpa);
+
+            if (IsRed_(uncle))
+            {
+                SetBlack_(father);
+                SetBlack_(uncle);
+                SetRed_  (grandpa);
+
+                cur_node = grandpa;
+            }
+
+            else if (cur_node == Left_(father))
+            {
+                cur_node = father;
+                RBT_HANDLE(RightRotate_(cur_node));
+            }
+
+            else
+            {
+                SetBlack_(father);
+                SetRed_  (grandpa);
+
+                RBT_HANDLE(LeftRotate_(grandpa));
+            }
+        }
+    }
+
+    SetBlack_(root_);
+}
+
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::DeleteNode_(Index del_node)
+{
+    if (del_node == NIL)
+        return;
+
+    Index y_node        = del_node;
+    bool  y_started_red = IsRed_(y_node);
+    Index fixup_node    = NIL;
+
+    if (Left_(del_node) == NIL)
+    {
+        fixup_node = Right_(del_node);
+        Transplant_(del_node, Right_(del_node));
+    }
+
+    else if (Right_(del_node) == NIL)
+    {
+        fixup_node = Left_(del_node);
+        Transplant_(del_node, Left_(del_node));
+    }
+
+    else
+    {
+        y_node        = GetMin_(Right_(del_node));
+        y_started_red = IsRed_(y_node);
+        fixup_node    = Right_(y_node);
+
+        if (Father_(y_node) == del_node)
+        {
+            SetFather_(fixup_node, y_node);
+        }
+
+        else
+        {
+            Transplant_(y_node, Right_(y_node));
+            nodes_[y_node].right = Right_(del_node);
+            SetFather_(Right_(y_node), y_node);
+        }
+
+        Transplant_(del_node, y_node);
+        nodes_[y_node].left = Left_(del_node);
+        SetFather_(Left_(y_node), y_node);
+        CopyColor_(y_node, del_node);
+    }
+
+    // fixup_node's father is the lowest node whose subtree lost a key
+    UpdateSizesUpward_(Father_(fixup_node));
+
+    DestroyNode_(del_node);
+
+    if (!y_started_red)
+        RBT_HANDLE(FixupDelete_(fixup_node));
+}
+
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::FixupDelete_(Index fixup_node)
+{
+    while (fixup_node != root_ && !IsRed_(fixup_node))
+    {
+        Index father = Father_(fixup_node);
+
+        if (fixup_node == Left_(father))
+        {
+            Index brother = Right_(father);
+
+            if (IsRed_(brother))
+            {
+                SetBlack_(brother);
+                SetRed_  (father);
+
+                RBT_HANDLE(LeftRotate_(father));
+
+                brother = Right_(father);
+            }
+
+
+            if (!IsRed_(Left_(brother)) && !IsRed_(Right_(brother)))
+            {
+                SetRed_(brother);
+                fixup_node = father;
+            }
+
+            else if (!IsRed_(Right_(brother)))
+            {
+                SetBlack_(Left_(brother));
+                SetRed_  (brother);
+
+                RBT_HANDLE(RightRotate_(brother));
+
+                brother = Right_(father);
+            }
+
+            else
+            {
+                CopyColor_(brother, father);
+                SetBlack_ (father);
+                SetBlack_ (Right_(brother));
+
+                RBT_HANDLE(LeftRotate_(father));
+
+                fixup_node = root_;
+            }
+        }
+
+        else
+        {
+            Index brother = Left_(father);
+
+            if (IsRed_(brother))
+            {
+                SetBlack_(brother);
+                SetRed_  (father);
+
+                RBT_HANDLE(RightRotate_(father));
+
+                brother = Left_(father);
+            }
+
+
+            if (!IsRed_(Right_(brother)) && !IsRed_(Left_(brother)))
+            {
+                SetRed_(brother);
+                fixup_node = father;
+            }
+
+            else if (!IsRed_(Left_(brother)))
+            {
+                SetBlack_(Right_(brother));
+                SetRed_  (brother);
+
+                RBT_HANDLE(LeftRotate_(brother));
+
+                brother = Left_(father);
+            }
+
+            else
+            {
+                CopyColor_(brother, father);
+                SetBlack_ (father);
+                SetBlack_ (Left_(brother));
+
+                RBT_HANDLE(RightRotate_(father));
+
+                fixup_node = root_;
+            }
+        }
+    }
+
+    SetBlack_(fixup_node);
+}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::BeginNode_() const
+{
+    if (root_ == NIL)
+        return NIL;
+
+    return GetMin_(root_);
+}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::Next_(Index node) const
+{
+    if (node == NIL)
+    {
+        RBT_WARNING("attempt to increment iterator on nil");
+        return BeginNode_();
+    }
+
+    if (Right_(node) != NIL)
+        return GetMin_(Right_(node));
+
+    Index father = Father_(node);
+
+    while (father != NIL && node == Right_(father))
+    {
+        node   = father;
+        father = Father_(node);
+    }
+
+    return father;
+}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::Prev_(Index node) const
+{
+    if (node == NIL)
+        return (root_ == NIL) ? NIL : GetMax_(root_);
+
+    Index prev = Predecessor_(node);
+
+    if (prev == NIL)
+        RBT_WARNING("attempt to decrement iterator on the first element");
+
+    return prev;
+}
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::Predecessor_(Index node) const
+{
+    RBT_ASSERT(node != NIL);
+
+    if (Left_(node) != NIL)
+        return GetMax_(Left_(node));
+
+    Index father = Father_(node);
+
+    while (father != NIL && node == Left_(father))
+    {
+        node   = father;
+        father = Father_(node);
+    }
+
+    return father;
+}
+
+
+template <typename KeyT, typename Comp>
+template <typename K>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::FindInSubtree_(Index sub_root, const K& key) const
+{
+    while (sub_root != NIL)
+    {
+        if (Before_(nodes_[sub_root].key, key))
+            sub_root = Right_(sub_root);
+
+        else if (Before_(key, nodes_[sub_root].key))
+            sub_root = Left_(sub_root);
+
+        else
+            return sub_root;
+    }
+
+    return NIL;
+}
+
+
+template <typename KeyT, typename Comp>
+template <typename K>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::LowerBoundNode_(const K& key) const
+{
+    Index result   = NIL;
+    Index cur_node = root_;
+
+    while (cur_node != NIL)
+    {
+        if (!Before_(nodes_[cur_node].key, key))
+        {
+            result   = cur_node;
+            cur_node = Left_(cur_node);
+        }
+
+        else
+        {
+            cur_node = Right_(cur_node);
+        }
+    }
+
+    return result;
+}
+
+template <typename KeyT, typename Comp>
+template <typename K>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::UpperBoundNode_(const K& key) const
+{
+    Index result   = NIL;
+    Index cur_node = root_;
+
+    while (cur_node != NIL)
+    {
+        if (Before_(key, nodes_[cur_node].key))
+        {
+            result   = cur_node;
+            cur_node = Left_(cur_node);
+        }
+
+        else
+        {
+            cur_node = Right_(cur_node);
+        }
+    }
+
+    return result;
+}
+
+
+template <typename KeyT, typename Comp>
+template <typename K>
+std::size_t CompactTree<KeyT, Comp>::CountLess_(const K& key) const
+{
+    std::size_t rank     = 0;
+    Index       cur_node = root_;
+
+    while (cur_node != NIL)
+    {
+        if (Before_(nodes_[cur_node].key, key))
+        {
+            rank    += nodes_[Left_(cur_node)].size + 1;
+            cur_node = Right_(cur_node);
+        }
+
+        else
+        {
+            cur_node = Left_(cur_node);
+        }
+    }
+
+    return rank;
+}
+
+template <typename KeyT, typename Comp>
+template <typename K>
+std::size_t CompactTree<KeyT, Comp>::CountNotGreater_(const K& key) const
+{
+    std::size_t count    = 0;
+    Index       cur_node = root_;
+
+    while (cur_node != NIL)
+    {
+        if (Before_(key, nodes_[cur_node].key))
+        {
+            cur_node = Left_(cur_node);
+        }
+
+        else
+        {
+            count   += nodes_[Left_(cur_node)].size + 1;
+            cur_node = Right_(cur_node);
+        }
+    }
+
+    return count;
+}
+
+template <typename KeyT, typename Comp>
+template <typename K>
+std::size_t CompactTree<KeyT, Comp>::CountInRange_(const K& lo, const K& hi) const
+{
+    if (Before_(hi, lo))
+        return 0;
+
+    return CountNotGreater_(hi) - CountLess_(lo);
+}
+
+
+template <typename KeyT, typename Comp>
+template <typename Fn>
+void CompactTree<KeyT, Comp>::ForEachInRange(const KeyT& lo, const KeyT& hi, Fn&& fn) const
+{
+    for (Index node = LowerBoundNode_(lo); node != NIL && !Before_(hi, nodes_[node].key); node = Next_(node))
+        fn(nodes_[node].key);
+}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::SelectNode_(std::size_t k) const
+{
+    Index cur_node = root_;
+
+    while (cur_node != NIL)
+    {
+        std::size_t left_size = nodes_[Left_(cur_node)].size;
+
+        if (k < left_size)
+            cur_node = Left_(cur_node);
+
+        else if (k == left_size)
+            return cur_node;
+
+        else
+        {
+            k -= left_size + 1;
+            cur_node = Right_(cur_node);
+        }
+    }
+
+    return NIL;
+}
+
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::UpdateSizesUpward_(Index from)
+{
+    for (Index cur_node = from; cur_node != NIL; cur_node = Father_(cur_node))
+    {
+        nodes_[cur_node].size = nodes_[Left_(cur_node)].size + nodes_[Right_(cur_node)].size + 1;
+    }
+}
+
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::GetMin_(Index subtree_root) const
+{
+    while (Left_(subtree_root) != NIL)
+        subtree_root = Left_(subtree_root);
+
+    return subtree_root;
+}
+
+template <typename KeyT, typename Comp>
+CompactTree<KeyT, Comp>::Index CompactTree<KeyT, Comp>::GetMax_(Index subtree_root) const
+{
+    while (Right_(subtree_root) != NIL)
+        subtree_root = Right_(subtree_root);
+
+    return subtree_root;
+}
+
+
+#ifndef NDEBUG
+
+template <typename KeyT, typename Comp>
+void CompactTree<KeyT, Comp>::Dump() const
+{
+    RLSU::Graphics::Graph graph(
+        [](size_t graph_size) -> size_t {
+            return (size_t)std::pow(2, std::log2(graph_size) / 2);
+        }
+    );
+
+    graph.AddNode(&nodes_[NIL], "nil", RLSU::Graphics::Colors::BLACK, RLSU::Graphics::Colors::BLACK, RLSU::Graphics::Colors::PINK);
+
+    if (root_ == NIL)
+    {
+        graph.LogGraph();
+        return;
+    }
+
+    for (Index node = BeginNode_(); node != NIL; node = Next_(node))
+    {
+        RLSU::Graphics::Graph::Node graph_node(&nodes_[node]);
+        graph_node.SetLabel("{}", nodes_[node].key);
+
+        if (node == root_)
+        {
+            graph_node.SetColor      (RLSU::Graphics::Colors::DARKDARKRED);
+            graph_node.SetBorderColor(RLSU::Graphics::Colors::PINK);
+            graph_node.SetFontcolor  (RLSU::Graphics::Colors::PINK);
+        }
+
+        else if (IsRed_(node))
+        {
+            graph_node.SetColor      (RLSU::Graphics::Colors::PINK);
+            graph_node.SetBorderColor(RLSU::Graphics::Colors::BLACK);
+            graph_node.SetFontcolor  (RLSU::Graphics::Colors::BLACK);
+        }
+
+        else
+        {
+            graph_node.SetColor      (RLSU::Graphics::Colors::BLACK);
+            graph_node.SetBorderColor(RLSU::Graphics::Colors::PINK);
+            graph_node.SetFontcolor  (RLSU::Graphics::Colors::PINK);
+        }
+
+        graph.AddNode(graph_node);
+    }
+
+    graph.AddEdge(&nodes_[NIL], &nodes_[root_], 1000);
+
+    for (Index node = BeginNode_(); node != NIL; node = Next_(node))
+    {
+        if (Left_(node) != NIL)
+            RBT_HANDLE(graph.AddEdge(&nodes_[node], &nodes_[Left_(node)], "l"));
+
+        if (Right_(node) != NIL)
+            RBT_HANDLE(graph.AddEdge(&nodes_[node], &nodes_[Right_(node)], "r"));
+    }
+
+    graph.LogGraph();
+}
+
+#endif
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+
+#include "RedBlackTree/arena.hpp"
+#include "RedBlackTree/tree.hpp"
+
+namespace Trees::RBT {
+
+// Tree behind a reader-writer lock: readers hold a shared lock and run at the same time,
+// writers hold the exclusive lock one at a time. A reader waits for the writer in progress
+// and a writer for the readers in progress. Readers get copies of keys, not iterators,
+// since iterators do not survive a writer.
+//
+// The walks are the plain Tree lookups. An optimistic lock-free walk (seqlock) would read
+// links and sizes while a writer changes them with plain stores, which is a data race no
+// version check can make defined. Reads that must never wait for a writer go to the
+// snapshots of PersistentTree (persistent_tree.hpp) instead.
+
+template <typename KeyT, typename Comp, typename Alloc = ArenaAllocator<KeyT>>
+class ConcurrentTree
+{
+public:
+    ConcurrentTree() = default;
+
+    template <std::input_iterator InputIt>
+    ConcurrentTree(InputIt first, InputIt last) : tree_(first, last) {}
+
+    ConcurrentTree(const ConcurrentTree&)            = delete;
+    ConcurrentTree& operator=(const ConcurrentTree&) = delete;
+
+    // writers, return the same as the Tree methods except iterators
+    bool        insert     (const KeyT& key);
+    bool        erase      (const KeyT& key);
+    std::size_t InsertBatch(std::span<const KeyT> batch) { return Write_([&] { return tree_.InsertBatch(batch); }); }
+
+    template <std::input_iterator InputIt>
+    void        BulkLoad(InputIt first, InputIt last)     { Write_([&] { tree_.BulkLoad(first, last); }); }
+
+    // readers, safe to call from any number of threads at once with writers
+    std::optional<KeyT> find      (const KeyT& key) const { return Read_([&] { return KeyOf_(tree_.find(key)); }); }
+    std::optional<KeyT> LowerBound(const KeyT& key) const { return Read_([&] { return KeyOf_(tree_.LowerBound(key)); }); }     // first not less then key
+    std::optional<KeyT> UpperBound(const KeyT& key) const { return Read_([&] { return KeyOf_(tree_.UpperBound(key)); }); }     // first greater  then key
+
+    bool        contains    (const KeyT& key) const               { return find(key).has_value(); }
+    std::size_t Rank        (const KeyT& key) const               { return Read_([&] { return tree_.Rank(key); }); }
+    std::size_t CountInRange(const KeyT& lo, const KeyT& hi) const { return Read_([&] { return tree_.CountInRange(lo, hi); }); }
+    std::size_t size        () const                              { return Read_([&] { return tree_.size(); }); }
+    bool        empty       () const                              { return size() == 0; }
+
+private:
+    using Tree = RBT::Tree<KeyT, Comp, Alloc>;
+
+    Tree                      tree_  = {};
+    mutable std::shared_mutex mutex_ = {};
+
+    template <typename Walk>
+    auto Read_(Walk walk) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return walk();
+    }
+
+    template <typename Change>
+    auto Write_(Change change)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        return change();
+    }
+
+    std::optional<KeyT> KeyOf_(typename Tree::const_iterator it) const { return it == tree_.end() ? std::nullopt : std::optional<KeyT>(*it); }
+};
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+bool ConcurrentTree<KeyT, Comp, Alloc>::insert(const KeyT& key)
+{
+    return Write_([&]
+    {
+        std::size_t old_size = tree_.size();
+        tree_.insert(key);
+
+        return tree_.size() != old_size;
+    });
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+bool ConcurrentTree<KeyT, Comp, Alloc>::erase(const KeyT& key)
+{
+    return Write_([&]
+    {
+        std::size_t old_size = tree_.size();
+        tree_.erase(key);
+
+        return tree_.size() != old_size;
+    });
+}
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Plumbing shared by the files of FrozenTree (Tree::Save) and Journal. Failures come back to
+// the caller as std::error_code: the errno of the failed call (system_category), or
+// FileIO::Error for a file that is readable but not of the expected format.
+
+namespace Trees::RBT::FileIO {
+
+enum class Error
+{
+    WRONG_FORMAT = 1,       // another kind of file, format version, key size or byte order
+};
+
+class ErrorCategory : public std::error_category
+{
+public:
+    const char* name() const noexcept override { return "RedBlackTree file"; }
+
+    std::string message(int value) const override
+    {
+        switch (static_cast<Error>(value))
+        {
+            case Error::WRONG_FORMAT: return "not a file of this format, key size or byte order";
+        }
+
+        return "unknown error";
+    }
+};
+
+inline const std::error_category& Category()
+{
+    static const ErrorCategory category;
+
+    return category;
+}
+
+inline std::error_code make_error_code(Error error) { return {static_cast<int>(error), Category()}; }
+
+// errno of the call that has just failed, read before anything else can overwrite it
+inline std::error_code LastError() { return {errno, std::system_category()}; }
+
+
+inline bool WriteAll(int fd, const void* data, std::size_t bytes)
+{
+    const char* pos = static_cast<const char*>(data);
+
+    while (bytes != 0)
+    {
+        ssize_t written = ::write(fd, pos, bytes);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written <= 0)
+        {
+            if (written == 0)
+                errno = EIO;
+
+            return false;
+        }
+
+        pos   += written;
+        bytes -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+}
+
+inline bool ReadAll(int fd, void* data, std::size_t bytes)
+{
+    char* pos = static_cast<char*>(data);
+
+    while (bytes != 0)
+    {
+        ssize_t got = ::read(fd, pos, bytes);
+
+        if (got < 0 && errno == EINTR)
+            continue;
+
+        if (got <= 0)
+        {
+            if (got == 0)
+                errno = EIO;
+
+            return false;
+        }
+
+        pos   += got;
+        bytes -= static_cast<std::size_t>(got);
+    }
+
+    return true;
+}
+
+
+// a new or renamed directory entry survives a crash only once the directory itself is synced
+inline bool SyncParentDirectory(const std::string& path)
+{
+    std::string::size_type slash = path.find_last_of('/');
+
+    std::string directory = (slash == std::string::npos) ? "." : (slash == 0) ? "/" : path.substr(0, slash);
+
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+
+    bool synced     = ::fsync(fd) == 0;
+    int  sync_errno = errno;
+
+    ::close(fd);
+
+    errno = sync_errno;
+
+    return synced;
+}
+
+}
+
+template <>
+struct std::is_error_code_enum<Trees::RBT::FileIO::Error> : std::true_type {};
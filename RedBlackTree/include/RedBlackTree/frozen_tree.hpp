@@ -0,0 +1,497 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#   include <immintrin.h>
+#endif
+
+#include "RedBlackTree/file_io.hpp"
+#include "RedBlackTree/tree.hpp"
+
+namespace Trees::RBT {
+
+// Read-only snapshot of a Tree for lookup-heavy phases. The sorted keys are the leaf layer
+// of an implicit B+-tree (S+-tree): blocks of 16 keys, every inner block holds the minimum
+// keys of the children 1..16 of its 17. Blocks are found by arithmetic instead of pointers,
+// so a lookup reads one cache line per layer, and the position in the leaf layer is the rank.
+// int keys in ascending order (Comp is std::greater) are compared 8 or 4 at a time with
+// AVX2 or SSE2, everything else with a branch-free scalar loop.
+//
+// The layout holds no pointers, so with trivially copyable keys it is also the file format:
+// a 64-byte header, then the layers as they are in memory. Open maps such a file and serves
+// lookups straight from the mapping. Copies share the keys, they are never written.
+
+template <typename KeyT, typename Comp>
+class FrozenTree
+{
+public:
+    using const_iterator = const KeyT*;
+
+    FrozenTree() = default;
+
+    template <typename Alloc>
+    explicit FrozenTree(const Tree<KeyT, Comp, Alloc>& tree);
+
+    // O(n): the keys are already sorted, so BulkLoad builds the tree without comparisons
+    template <typename Alloc = ArenaAllocator<KeyT>>
+    Tree<KeyT, Comp, Alloc> ToTree(const Alloc& alloc = Alloc()) const { return Tree<KeyT, Comp, Alloc>(begin(), end(), alloc); }
+
+    // Save writes to path.tmp, renames it over path and syncs the directory. Open returns nullopt
+    // for a missing file or one of another format, key size or byte order (FileIO::Error). On
+    // failure either sets error; the comparator is not stored, the file must have been saved
+    // with the same Comp
+    bool           Save(const std::string& path, std::error_code& error) const;
+    static std::optional<FrozenTree> Open(const std::string& path, std::error_code& error);
+
+    const_iterator begin() const { return keys_.get(); }
+    const_iterator end  () const { return keys_.get() + size_; }
+
+    std::size_t    size () const { return size_; }
+    bool           empty() const { return size_ == 0; }
+
+    const_iterator LowerBound(const KeyT& key) const { return begin() + Descend_<false>(key); }    // first not less then key
+    const_iterator UpperBound(const KeyT& key) const { return begin() + Descend_<true> (key); }    // first greater  then key
+
+    const_iterator find    (const KeyT& key) const;
+    bool           contains(const KeyT& key) const { return find(key) != end(); }
+
+    std::size_t    Rank        (const KeyT& key) const { return Descend_<false>(key); }            // number of keys less then key
+    std::size_t    CountInRange(const KeyT& lo, const KeyT& hi) const;                             // number of keys in [lo, hi]
+
+    void           CountInRangeBatch(std::span<const std::pair<KeyT, KeyT>> ranges, std::span<std::size_t> counts) const;
+
+    const_iterator Select(std::size_t k) const { return begin() + std::min(k, size_); }            // end() if k >= size()
+
+private:
+    static constexpr std::size_t BLOCK_KEYS = 16;
+    static constexpr std::size_t FANOUT     = BLOCK_KEYS + 1;
+    static constexpr std::size_t LINE_SIZE  = 64;
+
+    static constexpr bool SIMD_KEYS = std::is_same_v<KeyT, int> &&
+                                      (std::is_same_v<Comp, std::greater<int>> || std::is_same_v<Comp, std::greater<>>);
+
+    template <typename T>
+    struct LineAllocator_
+    {
+        using value_type = T;
+
+        LineAllocator_() = default;
+        template <typename U>
+        LineAllocator_(const LineAllocator_<U>&) {}
+
+        T*   allocate  (std::size_t n)     { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(LINE_SIZE))); }
+        void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t(LINE_SIZE)); }
+
+        template <typename U>
+        bool operator==(const LineAllocator_<U>&) const { return true; }
+    };
+
+    [[no_unique_address]] Comp comparator_ = {};
+
+    std::size_t size_ = 0;
+
+    // all layers block after block: leaves first, the single root block last; the tail of
+    // every layer is padded with the maximum key, which never sends a lookup too far left.
+    // Points into a LineAllocator_ vector or into a file mapping, either is kept alive here
+    std::shared_ptr<const KeyT> keys_ = {};
+
+    std::vector<std::size_t> layer_begin_  = {};    // index of the first key of each layer
+    std::vector<std::size_t> layer_blocks_ = {};
+
+    static constexpr char          FILE_MAGIC[8]   = {'R', 'B', 'T', 'S', 'T', 'R', 'E', 'E'};
+    static constexpr std::uint32_t FILE_VERSION    = 1;
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    struct FileHeader_
+    {
+        char          magic[8];
+        std::uint32_t version;
+        std::uint32_t key_size;         // sizeof(KeyT)
+        std::uint32_t block_keys;       // BLOCK_KEYS
+        std::uint32_t byte_order;       // BYTE_ORDER_MARK as the saving machine stores it
+        std::uint64_t size;             // keys in the tree
+        std::uint64_t stored_keys;      // keys in all layers, padding included
+        char          reserved[24];     // the layers start on a cache line boundary
+    };
+
+    static_assert(sizeof(FileHeader_) == LINE_SIZE);
+
+    bool           Before_(const KeyT& lhs, const KeyT& rhs) const { return comparator_(rhs, lhs); }
+
+    // fills layer_blocks_ and layer_begin_ for size_ keys, returns the number of keys in all layers
+    std::size_t    Layout_();
+
+    // number of keys less than key (UPPER: not greater than key) in the whole snapshot
+    template <bool UPPER>
+    std::size_t    Descend_(const KeyT& key) const;
+
+    // the same count within one block of BLOCK_KEYS keys
+    template <bool UPPER>
+    std::size_t    CountInBlock_(const KeyT* block, const KeyT& key) const;
+};
+
+
+template <typename KeyT, typename Comp>
+template <typename Alloc>
+FrozenTree<KeyT, Comp>::FrozenTree(const Tree<KeyT, Comp, Alloc>& tree)
+    : comparator_(tree.key_comp())
+    , size_(tree.size())
+{
+    if (size_ == 0)
+        return;
+
+    auto storage = std::make_shared<std::vector<KeyT, LineAllocator_<KeyT>>>();
+    auto& keys   = *storage;
+
+    keys.reserve(Layout_());
+
+    // the stack walk of ForEachInRange is cheaper than iterator steps over scattered nodes
+    tree.ForEachInRange(tree.front(), tree.back(), [&keys](const KeyT& key) { keys.push_back(key); });
+
+    const KeyT max_key = keys.back();
+
+    keys.resize(layer_blocks_[0] * BLOCK_KEYS, max_key);
+
+    // the separator before child c of a layer h block is the first key of the leftmost
+    // leaf under c, that is of leaf block c * FANOUT^(h-1)
+    std::size_t leaves_per_child = 1;
+
+    for (std::size_t layer = 1; layer < layer_blocks_.size(); ++layer)
+    {
+        std::size_t children = layer_blocks_[layer - 1];
+
+        for (std::size_t block = 0; block < layer_blocks_[layer]; ++block)
+        {
+            for (std::size_t slot = 0; slot < BLOCK_KEYS; ++slot)
+            {
+                std::size_t child = block * FANOUT + slot + 1;
+
+                keys.push_back(child < children ? keys[child * leaves_per_child * BLOCK_KEYS] : max_key);
+            }
+        }
+
+        leaves_per_child *= FANOUT;
+    }
+
+    keys_ = std::shared_ptr<const KeyT>(storage, keys.data());
+}
+
+
+template <typename KeyT, typename Comp>
+std::size_t FrozenTree<KeyT, Comp>::Layout_()
+{
+    layer_blocks_.clear();
+    layer_begin_ .clear();
+
+    if (size_ == 0)
+        return 0;
+
+    layer_blocks_.push_back((size_ + BLOCK_KEYS - 1) / BLOCK_KEYS);
+
+    while (layer_blocks_.back() > 1)
+        layer_blocks_.push_back((layer_blocks_.back() + FANOUT - 1) / FANOUT);
+
+    std::size_t total_keys = 0;
+
+    for (std::size_t blocks : layer_blocks_)
+    {
+        layer_begin_.push_back(total_keys);
+        total_keys += blocks * BLOCK_KEYS;
+    }
+
+    return total_keys;
+}
+
+
+template <typename KeyT, typename Comp>
+bool FrozenTree<KeyT, Comp>::Save(const std::string& path, std::error_code& error) const
+{
+    static_assert(std::is_trivially_copyable_v<KeyT>, "only trivially copyable keys can be saved");
+
+    std::size_t stored_keys = layer_begin_.empty() ? 0 : layer_begin_.back() + layer_blocks_.back() * BLOCK_KEYS;
+
+    FileHeader_ header = {};
+
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.version     = FILE_VERSION;
+    header.key_size    = sizeof(KeyT);
+    header.block_keys  = BLOCK_KEYS;
+    header.byte_order  = BYTE_ORDER_MARK;
+    header.size        = size_;
+    header.stored_keys = stored_keys;
+
+    // a crash while saving leaves the old file in place, never a torn one
+    std::string tmp_path = path + ".tmp";
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        error = FileIO::LastError();
+        return false;
+    }
+
+    bool written = FileIO::WriteAll(fd, &header, sizeof(header)) &&
+                   FileIO::WriteAll(fd, keys_.get(), stored_keys * sizeof(KeyT)) &&
+                   ::fsync(fd) == 0;
+
+    if (!written)
+        error = FileIO::LastError();
+
+    if (::close(fd) != 0 && written)
+    {
+        error   = FileIO::LastError();
+        written = false;
+    }
+
+    if (written && ::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        error   = FileIO::LastError();
+        written = false;
+    }
+
+    if (!written)
+    {
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+
+    // until then a crash may bring back the old file, or no file at all
+    if (!FileIO::SyncParentDirectory(path))
+    {
+        error = FileIO::LastError();
+        return false;
+    }
+
+    error.clear();
+    return true;
+}
+
+
+template <typename KeyT, typename Comp>
+std::optional<FrozenTree<KeyT, Comp>> FrozenTree<KeyT, Comp>::Open(const std::string& path, std::error_code& error)
+{
+    static_assert(std::is_trivially_copyable_v<KeyT>, "only trivially copyable keys can be mapped");
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        error = FileIO::LastError();
+        return std::nullopt;
+    }
+
+    struct stat info = {};
+
+    if (::fstat(fd, &info) != 0)
+    {
+        error = FileIO::LastError();
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    std::size_t file_size = static_cast<std::size_t>(info.st_size);
+    void*       mapped    = MAP_FAILED;
+
+    if (file_size < sizeof(FileHeader_))
+        error = FileIO::Error::WRONG_FORMAT;
+    else if ((mapped = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        error = FileIO::LastError();
+
+    ::close(fd);
+
+    if (mapped == MAP_FAILED)
+        return std::nullopt;
+
+    std::shared_ptr<const void> mapping(mapped, [file_size](const void* addr) { ::munmap(const_cast<void*>(addr), file_size); });
+
+    FileHeader_ header = {};
+    std::memcpy(&header, mapped, sizeof(header));
+
+    bool valid = std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version    == FILE_VERSION    &&
+                 header.key_size   == sizeof(KeyT)    &&
+                 header.block_keys == BLOCK_KEYS      &&
+                 header.byte_order == BYTE_ORDER_MARK &&
+                 header.size       <= file_size / sizeof(KeyT);
+
+    FrozenTree frozen;
+
+    frozen.size_ = valid ? static_cast<std::size_t>(header.size) : 0;
+
+    std::size_t stored_keys = frozen.Layout_();
+
+    if (!valid || header.stored_keys != stored_keys || file_size != sizeof(FileHeader_) + stored_keys * sizeof(KeyT))
+    {
+        error = FileIO::Error::WRONG_FORMAT;
+        return std::nullopt;
+    }
+
+    const KeyT* keys = reinterpret_cast<const KeyT*>(static_cast<const char*>(mapped) + sizeof(FileHeader_));
+
+    frozen.keys_ = std::shared_ptr<const KeyT>(mapping, keys);
+
+    // every lookup reads the inner layers, a sixteenth of the file: fetch them ahead of time
+    if (frozen.layer_begin_.size() > 1)
+    {
+        auto        page  = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+        auto        inner = reinterpret_cast<std::uintptr_t>(keys + frozen.layer_begin_[1]) & ~(page - 1);
+        std::size_t bytes = reinterpret_cast<std::uintptr_t>(keys + stored_keys) - inner;
+
+        ::madvise(reinterpret_cast<void*>(inner), bytes, MADV_WILLNEED);
+    }
+
+    error.clear();
+    return frozen;
+}
+
+
+
+template <typename KeyT, typename Comp>
+typename FrozenTree<KeyT, Comp>::const_iterator FrozenTree<KeyT, Comp>::find(const KeyT& key) const
+{
+    const_iterator found = LowerBound(key);
+
+    return (found != end() && !Before_(key, *found)) ? found : end();
+}
+
+
+template <typename KeyT, typename Comp>
+std::size_t FrozenTree<KeyT, Comp>::CountInRange(const KeyT& lo, const KeyT& hi) const
+{
+    if (Before_(hi, lo))
+        return 0;
+
+    return Descend_<true>(hi) - Descend_<false>(lo);
+}
+
+
+template <typename KeyT, typename Comp>
+void FrozenTree<KeyT, Comp>::CountInRangeBatch(std::span<const std::pair<KeyT, KeyT>> ranges, std::span<std::size_t> counts) const
+{
+    RBT_ASSERT(counts.size() >= ranges.size());
+
+    // the lookups are independent and touch a few lines each, the CPU overlaps them by itself
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+        counts[i] = CountInRange(ranges[i].first, ranges[i].second);
+}
+
+
+template <typename KeyT, typename Comp>
+template <bool UPPER>
+std::size_t FrozenTree<KeyT, Comp>::Descend_(const KeyT& key) const
+{
+    if (size_ == 0)
+        return 0;
+
+    std::size_t block = 0;
+
+    // a key above the maximum counts the padding too and may point past the last block of
+    // the next layer, the clamp keeps it on the last one; the final count is clamped likewise
+    for (std::size_t layer = layer_blocks_.size() - 1; layer > 0; --layer)
+    {
+        std::size_t child = CountInBlock_<UPPER>(keys_.get() + layer_begin_[layer] + block * BLOCK_KEYS, key);
+
+        block = std::min(block * FANOUT + child, layer_blocks_[layer - 1] - 1);
+    }
+
+    std::size_t rank = block * BLOCK_KEYS + CountInBlock_<UPPER>(keys_.get() + block * BLOCK_KEYS, key);
+
+    return std::min(rank, size_);
+}
+
+
+template <typename KeyT, typename Comp>
+template <bool UPPER>
+std::size_t FrozenTree<KeyT, Comp>::CountInBlock_(const KeyT* block, const KeyT& key) const
+{
+    if constexpr (SIMD_KEYS)
+    {
+#if defined(__AVX2__)
+        __m256i keys = _mm256_set1_epi32(key);
+        __m256i lo   = _mm256_load_si256(reinterpret_cast<const __m256i*>(block));
+        __m256i hi   = _mm256_load_si256(reinterpret_cast<const __m256i*>(block + 8));
+
+        // lower: block[i] < key, upper: !(block[i] > key)
+        __m256i lo_mask = UPPER ? _mm256_cmpgt_epi32(lo, keys) : _mm256_cmpgt_epi32(keys, lo);
+        __m256i hi_mask = UPPER ? _mm256_cmpgt_epi32(hi, keys) : _mm256_cmpgt_epi32(keys, hi);
+
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(lo_mask))) |
+                        static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(hi_mask))) << 8;
+
+        std::size_t count = static_cast<std::size_t>(std::popcount(mask));
+
+        return UPPER ? BLOCK_KEYS - count : count;
+#elif defined(__SSE2__)
+        __m128i  keys = _mm_set1_epi32(key);
+        unsigned mask = 0;
+
+        for (std::size_t quarter = 0; quarter < 4; ++quarter)
+        {
+            __m128i part      = _mm_load_si128(reinterpret_cast<const __m128i*>(block + quarter * 4));
+            __m128i part_mask = UPPER ? _mm_cmpgt_epi32(part, keys) : _mm_cmpgt_epi32(keys, part);
+
+            mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(part_mask))) << (quarter * 4);
+        }
+
+        std::size_t count = static_cast<std::size_t>(std::popcount(mask));
+
+        return UPPER ? BLOCK_KEYS - count : count;
+#endif
+    }
+
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i < BLOCK_KEYS; ++i)
+        count += UPPER ? !Before_(key, block[i]) : Before_(block[i], key);
+
+    return count;
+}
+
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+bool Tree<KeyT, Comp, Alloc>::Save(const std::string& path, std::error_code& error) const
+{
+    return FrozenTree<KeyT, Comp>(*this).Save(path, error);
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+std::optional<FrozenTree<KeyT, Comp>> Tree<KeyT, Comp, Alloc>::Open(const std::string& path, std::error_code& error)
+{
+    return FrozenTree<KeyT, Comp>::Open(path, error);
+}
+
+// the keys come sorted and unique, so BulkLoad takes its linear path
+template <typename KeyT, typename Comp, typename Alloc>
+std::optional<Tree<KeyT, Comp, Alloc>> Tree<KeyT, Comp, Alloc>::Load(const std::string& path, std::error_code& error, const Alloc& alloc)
+{
+    std::optional<FrozenTree<KeyT, Comp>> frozen = FrozenTree<KeyT, Comp>::Open(path, error);
+
+    if (!frozen)
+        return std::nullopt;
+
+    return frozen->ToTree(alloc);
+}
+
+}
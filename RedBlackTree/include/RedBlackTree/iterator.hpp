@@ -1,48 +1,55 @@
 #pragma once
 
 #include <iostream>
+#include <type_traits>
 
 #include "RedBlackTree/node.hpp"
-#include "RLogSU/logger.hpp"
+#include "RedBlackTree/trace.hpp"
 
 namespace Trees::RBT {
 
-template <typename KeyT, typename Comp>
+template <typename KeyT, typename Comp, typename Alloc>
 class Tree;
 
-template <typename TreeKeyT, typename TreeComp, typename IteratorKeyT>
+template <typename TreeKeyT, typename TreeComp, typename TreeAlloc, typename IteratorKeyT>
 class RBTIterator
 {
-    friend class Tree<TreeKeyT, TreeComp>;
+    friend class Tree<TreeKeyT, TreeComp, TreeAlloc>;
 
-    template<typename A, typename B, typename C>
+    template<typename A, typename B, typename C, typename D>
     friend class RBTIterator;
 
     using Node = RBT::RBTNode<TreeKeyT, TreeComp>;
 
-    using iterator_category = std::forward_iterator_tag;
-    using value_type        = IteratorKeyT;
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = std::remove_const_t<IteratorKeyT>;
     using difference_type   = std::ptrdiff_t;
     using pointer           = IteratorKeyT*;
     using reference         = IteratorKeyT&;
 
 private:
-    explicit RBTIterator(const Tree<TreeKeyT, TreeComp>* tree, Node *node_ptr)
+    explicit RBTIterator(const Tree<TreeKeyT, TreeComp, TreeAlloc>* tree, Node *node_ptr)
     : tree_(tree)
     , node_ptr_(node_ptr)
     {}
     
 public:
-    const IteratorKeyT& operator*()  const { return node_ptr_->key; }
-          IteratorKeyT& operator*()        { return node_ptr_->key; }
-    
-    const IteratorKeyT* operator->() const { return &node_ptr_->key; }
-          IteratorKeyT* operator->()       { return &node_ptr_->key; }
+    RBTIterator() = default;
+
+    // iterator converts to const_iterator
+    template <typename OtherKeyT>
+    requires (std::is_const_v<IteratorKeyT> && std::is_same_v<OtherKeyT, std::remove_const_t<IteratorKeyT>>)
+    RBTIterator(const RBTIterator<TreeKeyT, TreeComp, TreeAlloc, OtherKeyT>& other)
+    : tree_(other.tree_)
+    , node_ptr_(other.node_ptr_)
+    {}
+
+    IteratorKeyT& operator*()  const { return node_ptr_->key; }
+    IteratorKeyT* operator->() const { return &node_ptr_->key; }
 
     Node* get() const { return node_ptr_; }
 
-    // operator RBTIterator<TreeKeyT, TreeComp, const IteratorKeyT>() const { return RBTIterator<TreeKeyT, TreeComp, const IteratorKeyT>(tree_, node_ptr_); }
-    
     RBTIterator& operator++()
     {
         *this = GetNext_();
@@ -56,6 +63,20 @@ public:
         return temp;
     }
 
+    // --end() is the maximum
+    RBTIterator& operator--()
+    {
+        *this = GetPrev_();
+        return *this;
+    };
+
+    RBTIterator operator--(int)
+    {
+        RBTIterator temp = *this;
+        --(*this);
+        return temp;
+    }
+
     bool operator==(const RBTIterator& other) const
     {
         return this->get() == other.get();
@@ -67,43 +88,32 @@ public:
     };
 
 private:
-    const Tree<TreeKeyT, TreeComp>* tree_;
-    Node* node_ptr_;
+    const Tree<TreeKeyT, TreeComp, TreeAlloc>* tree_    = nullptr;
+    Node*                                      node_ptr_ = nullptr;
 
 
-    [[nodiscard]] RBTIterator GetNext_()
+    [[nodiscard]] RBTIterator GetNext_() const
     {
-        Node* cur_node = node_ptr_;
-        
-        if (cur_node == tree_->nil_)
-        {
-            RLSU_WARNING("attempt to increment iterator on nil");
-            return RBTIterator(tree_, tree_->GetMin_(tree_->root_));
-        }
-
-        if (cur_node->right != tree_->nil_)
+        if (node_ptr_ == tree_->nil_)
         {
-            cur_node = cur_node->right;
-
-            while (cur_node->left != tree_->nil_)
-            {
-                cur_node = cur_node->left;
-            }
-
-            return RBTIterator(tree_, cur_node);
+            RBT_WARNING("attempt to increment iterator on nil");
+            return RBTIterator(tree_, tree_->leftmost_);
         }
 
-        // else
+        return RBTIterator(tree_, tree_->Successor_(node_ptr_));
+    }
 
-        Node* father = cur_node->father;
+    [[nodiscard]] RBTIterator GetPrev_() const
+    {
+        if (node_ptr_ == tree_->nil_)
+            return RBTIterator(tree_, tree_->rightmost_);
 
-        while (father != tree_->nil_ && cur_node == father->right)
+        if (node_ptr_ == tree_->leftmost_)
         {
-            cur_node = father;
-            father = cur_node->father;
+            RBT_WARNING("attempt to decrement iterator on the first element");
         }
 
-        return RBTIterator(tree_, father);
+        return RBTIterator(tree_, tree_->Predecessor_(node_ptr_));
     }
 };
 
@@ -111,10 +121,10 @@ private:
 
 
 namespace std {
-    template <typename TreeKeyT, typename TreeComp, typename IteratorKeyT>
-    struct iterator_traits<Trees::RBT::RBTIterator<TreeKeyT, TreeComp, IteratorKeyT>> {
-        using iterator_category = std::forward_iterator_tag;
-        using value_type        = IteratorKeyT;
+    template <typename TreeKeyT, typename TreeComp, typename TreeAlloc, typename IteratorKeyT>
+    struct iterator_traits<Trees::RBT::RBTIterator<TreeKeyT, TreeComp, TreeAlloc, IteratorKeyT>> {
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = std::remove_const_t<IteratorKeyT>;
         using difference_type   = ptrdiff_t;
         using pointer           = IteratorKeyT*;
         using reference         = IteratorKeyT&;
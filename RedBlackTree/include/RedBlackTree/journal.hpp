@@ -0,0 +1,711 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RedBlackTree/file_io.hpp"
+#include "RedBlackTree/tree.hpp"
+
+namespace Trees::RBT {
+
+// Append-only journal of inserts and erases (write-ahead log) for rebuilding a Tree after a
+// crash. Appends only copy the record into a buffer; a flusher thread writes the buffer as
+// one checksummed batch and calls fdatasync once for all of it (group commit). A batch is
+// written when it reaches group_records, when its oldest record waited sync_interval, or at
+// once when somebody waits in WaitDurable() or Sync(). Records appended while a sync is in
+// flight form the next batch, so concurrent waiters share syncs instead of queueing for them.
+//
+// A crash can leave a torn last batch; its checksum fails, replay stops before it and Open
+// cuts it off, reporting the size in TornBytes(). Failures come back as std::error_code (see
+// file_io.hpp). Keys are stored as raw bytes, so they must be trivially copyable.
+
+struct JournalOptions
+{
+    std::size_t               group_records       = 4096;                           // batch size that is written at once
+    std::chrono::milliseconds sync_interval       = std::chrono::milliseconds(5);   // most time a record waits unsynced
+    std::size_t               max_pending_records = std::size_t(1) << 20;           // appends block above it until a sync
+};
+
+template <typename KeyT>
+class Journal
+{
+    static_assert(std::is_trivially_copyable_v<KeyT>, "journal records store keys as raw bytes");
+
+public:
+    enum class Op : std::uint8_t
+    {
+        INSERT = 'i',
+        ERASE  = 'e',
+    };
+
+    // creates the file if it is missing (and syncs its directory) and cuts off a torn tail;
+    // nullptr on I/O errors and for a file of another format, key size or byte order, which
+    // set error
+    static std::unique_ptr<Journal> Open(const std::string& path, std::error_code& error, const JournalOptions& options = {});
+
+    Journal(const Journal&)            = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    ~Journal();     // writes and syncs what is still buffered
+
+    // any number of threads may append at once; the result is the sequence number of the
+    // (last) record, it is durable once WaitDurable returned true for it
+    std::uint64_t Append(Op op, const KeyT& key)              { return Append(op, std::span<const KeyT>(&key, 1)); }
+    std::uint64_t Append(Op op, std::span<const KeyT> keys);
+
+    bool          WaitDurable(std::uint64_t seq);     // false if a write or sync failed, nothing is durable after that
+    bool          Sync();                             // WaitDurable for everything appended so far
+
+    // drops every record, for when a snapshot has made them redundant; no appends may run meanwhile
+    bool          Reset();
+
+    bool            Failed   () const;
+    std::error_code Error    () const;     // why the first write, sync or truncate failed, empty if none did
+    std::uint64_t   SyncCount() const;     // fdatasync calls so far, records / syncs is the mean group size
+    std::size_t     TornBytes() const { return torn_bytes_; }     // of a torn last batch Open cut off, 0 for a clean file
+
+    // applies the records of the file at path to tree: the last record of each key decides
+    // whether it is present, so the records are sorted by key, reduced to their final state
+    // and applied with one Difference and one Union. Returns the number of records read,
+    // nullopt if the file is missing, unreadable or not a journal, which sets error
+    template <typename Comp, typename Alloc>
+    static std::optional<std::size_t> Replay(const std::string& path, Tree<KeyT, Comp, Alloc>& tree, std::error_code& error);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr char          FILE_MAGIC[8]   = {'R', 'B', 'T', 'J', 'R', 'N', 'L', '1'};
+    static constexpr std::uint32_t BATCH_MAGIC     = 0x4254424a;    // "JBTB"
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr std::size_t   RECORD_SIZE     = 1 + sizeof(KeyT);     // op byte and the key, unaligned
+
+    struct FileHeader_
+    {
+        char          magic[8];
+        std::uint32_t key_size;         // sizeof(KeyT)
+        std::uint32_t byte_order;       // BYTE_ORDER_MARK as the writing machine stores it
+    };
+
+    struct BatchHeader_
+    {
+        std::uint32_t magic;            // BATCH_MAGIC
+        std::uint32_t records;
+        std::uint64_t checksum;         // of the records that follow
+    };
+
+    Journal(int fd, const JournalOptions& options, std::size_t torn_bytes);
+
+    int                     fd_         = -1;   // opened with O_APPEND, written only by the flusher
+    JournalOptions          options_    = {};
+    std::size_t             torn_bytes_ = 0;
+
+    mutable std::mutex      mutex_        = {};
+    std::condition_variable flush_wanted_ = {};     // wakes the flusher
+    std::condition_variable synced_       = {};     // wakes WaitDurable and blocked appends
+
+    std::vector<char>       pending_         = {};  // encoded records of the next batch
+    std::size_t             pending_records_ = 0;
+    Clock::time_point       oldest_pending_  = {};
+    std::uint64_t           appended_        = 0;   // sequence number of the last appended record
+    std::uint64_t           durable_         = 0;   // ... of the last synced one
+    std::uint64_t           wanted_          = 0;   // ... of the last one somebody waits for
+    std::uint64_t           syncs_           = 0;
+    bool                    failed_          = false;
+    std::error_code         error_           = {};  // of the first failure
+    bool                    stop_            = false;
+
+    std::thread             flusher_ = {};
+
+    void            FlushLoop_();
+    std::error_code WriteBatch_(const std::vector<char>& records, std::size_t count);
+    void            Fail_(std::error_code error);     // under the lock
+
+    // calls on_record(op, key) for every record of intact batches, returns the offset where
+    // they end, or nullopt and error if the file cannot be read or the header does not match
+    template <typename Fn>
+    static std::optional<std::size_t> Scan_(int fd, std::error_code& error, Fn&& on_record);
+
+    static FileHeader_   MakeHeader_();
+    static std::uint64_t Checksum_(const char* data, std::size_t bytes);
+};
+
+// Tree whose changes go to a Journal, recovered from the last snapshot plus the journal.
+// Writers must not run concurrently, as for Tree; durability is decided by Sync().
+template <typename KeyT, typename Comp, typename Alloc = ArenaAllocator<KeyT>>
+class DurableTree
+{
+public:
+    using Tree = RBT::Tree<KeyT, Comp, Alloc>;
+
+    // loads the snapshot (Tree::Save format) if it exists, replays the journal over it and
+    // appends to the journal from then on; nullopt if either is unreadable, which sets error.
+    // journal().TornBytes() tells whether the journal ended in a torn batch
+    static std::optional<DurableTree> Open(const std::string& snapshot_path, const std::string& journal_path,
+                                           std::error_code& error, const JournalOptions& options = {});
+
+    // the tree changes at once, the journal record becomes durable with the next sync
+    bool        insert     (const KeyT& key);     // true if key was new
+    bool        erase      (const KeyT& key);     // true if key was present
+    std::size_t InsertBatch(std::span<const KeyT> batch);
+
+    bool        Sync() { return journal_->Sync(); }     // journal().Error() tells why it failed
+
+    // saves a snapshot and empties the journal once the snapshot and its directory entry are
+    // synced; a crash in between only replays records the snapshot already contains
+    bool        Checkpoint(std::error_code& error);
+
+    const Tree&      tree   () const { return tree_; }
+    Journal<KeyT>&   journal()       { return *journal_; }
+
+private:
+    using Op = typename Journal<KeyT>::Op;
+
+    DurableTree(Tree&& tree, std::unique_ptr<Journal<KeyT>> journal, std::string snapshot_path)
+        : tree_(std::move(tree)), journal_(std::move(journal)), snapshot_path_(std::move(snapshot_path)) {}
+
+    Tree                           tree_          = {};
+    std::unique_ptr<Journal<KeyT>> journal_       = {};
+    std::string                    snapshot_path_ = {};
+};
+
+
+template <typename KeyT>
+Journal<KeyT>::Journal(int fd, const JournalOptions& options, std::size_t torn_bytes)
+    : fd_(fd), options_(options), torn_bytes_(torn_bytes)
+{
+    options_.group_records       = std::max<std::size_t>(options_.group_records, 1);
+    options_.max_pending_records = std::max(options_.max_pending_records, options_.group_records);
+
+    pending_.reserve(options_.group_records * RECORD_SIZE);
+
+    flusher_ = std::thread([this] { FlushLoop_(); });
+}
+
+
+template <typename KeyT>
+Journal<KeyT>::~Journal()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+
+    flush_wanted_.notify_one();
+    flusher_.join();
+
+    ::close(fd_);
+}
+
+
+template <typename KeyT>
+std::unique_ptr<Journal<KeyT>> Journal<KeyT>::Open(const std::string& path, std::error_code& error, const JournalOptions& options)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        error = FileIO::LastError();
+        return nullptr;
+    }
+
+    struct stat info = {};
+
+    bool        ok         = ::fstat(fd, &info) == 0;
+    std::size_t file_size  = ok ? static_cast<std::size_t>(info.st_size) : 0;
+    std::size_t torn_bytes = 0;
+
+    if (ok && file_size < sizeof(FileHeader_))
+    {
+        // new, or created by a run that crashed before the header was synced; the
+        // directory entry of a new file is durable only once the directory is synced
+        FileHeader_ header = MakeHeader_();
+
+        ok = ::ftruncate(fd, 0) == 0 && FileIO::WriteAll(fd, &header, sizeof(header)) && ::fsync(fd) == 0 &&
+             FileIO::SyncParentDirectory(path);
+    }
+    else if (ok)
+    {
+        std::optional<std::size_t> intact = Scan_(fd, error, [](Op, const KeyT&) {});
+
+        if (!intact)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        torn_bytes = file_size - *intact;
+
+        if (torn_bytes != 0)
+            ok = ::ftruncate(fd, static_cast<off_t>(*intact)) == 0 && ::fsync(fd) == 0;
+    }
+
+    if (!ok)
+    {
+        error = FileIO::LastError();
+        ::close(fd);
+        return nullptr;
+    }
+
+    error.clear();
+    return std::unique_ptr<Journal>(new Journal(fd, options, torn_bytes));
+}
+
+
+template <typename KeyT>
+std::uint64_t Journal<KeyT>::Append(Op op, std::span<const KeyT> keys)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    synced_.wait(lock, [&] { return pending_records_ < options_.max_pending_records || failed_; });
+
+    if (pending_records_ == 0)
+        oldest_pending_ = Clock::now();
+
+    for (const KeyT& key : keys)
+    {
+        std::size_t end = pending_.size();
+
+        pending_.resize(end + RECORD_SIZE);
+        pending_[end] = static_cast<char>(op);
+        std::memcpy(pending_.data() + end + 1, &key, sizeof(KeyT));
+    }
+
+    pending_records_ += keys.size();
+    appended_        += keys.size();
+
+    std::uint64_t seq = appended_;
+
+    bool full = pending_records_ >= options_.group_records;
+
+    lock.unlock();
+
+    if (full)
+        flush_wanted_.notify_one();
+
+    return seq;
+}
+
+
+template <typename KeyT>
+bool Journal<KeyT>::WaitDurable(std::uint64_t seq)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (durable_ >= seq || failed_)
+        return !failed_;
+
+    wanted_ = std::max(wanted_, seq);
+    flush_wanted_.notify_one();
+
+    synced_.wait(lock, [&] { return durable_ >= seq || failed_; });
+
+    return !failed_;
+}
+
+
+template <typename KeyT>
+bool Journal<KeyT>::Sync()
+{
+    std::uint64_t seq = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seq = appended_;
+    }
+
+    return WaitDurable(seq);
+}
+
+
+template <typename KeyT>
+bool Journal<KeyT>::Reset()
+{
+    if (!Sync())
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (::ftruncate(fd_, sizeof(FileHeader_)) != 0 || ::fsync(fd_) != 0)
+        Fail_(FileIO::LastError());
+
+    return !failed_;
+}
+
+
+template <typename KeyT>
+bool Journal<KeyT>::Failed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+
+template <typename KeyT>
+std::error_code Journal<KeyT>::Error() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+
+template <typename KeyT>
+std::uint64_t Journal<KeyT>::SyncCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return syncs_;
+}
+
+
+// the only writer of the file: takes the whole buffer, writes and syncs it without the lock
+template <typename KeyT>
+void Journal<KeyT>::FlushLoop_()
+{
+    std::vector<char> batch;
+    batch.reserve(pending_.capacity());
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        if (pending_records_ == 0)
+        {
+            if (stop_)
+                break;
+
+            flush_wanted_.wait(lock);
+            continue;
+        }
+
+        Clock::time_point deadline = oldest_pending_ + options_.sync_interval;
+
+        bool due = stop_ || failed_ || wanted_ > durable_ ||
+                   pending_records_ >= options_.group_records || Clock::now() >= deadline;
+
+        if (!due)
+        {
+            flush_wanted_.wait_until(lock, deadline);
+            continue;
+        }
+
+        batch.swap(pending_);
+
+        std::size_t   count = std::exchange(pending_records_, 0);
+        std::uint64_t last  = appended_;
+        bool          write = !failed_;     // after a failure the file may end in a torn batch, nothing goes after it
+
+        synced_.notify_all();     // appends blocked on max_pending_records may go on
+
+        lock.unlock();
+
+        std::error_code error = write ? WriteBatch_(batch, count) : std::error_code();
+
+        lock.lock();
+
+        if (write && !error)
+        {
+            durable_ = last;
+            ++syncs_;
+        }
+        else if (write)
+        {
+            Fail_(error);
+        }
+
+        batch.clear();
+        synced_.notify_all();
+    }
+}
+
+
+template <typename KeyT>
+void Journal<KeyT>::Fail_(std::error_code error)
+{
+    if (!failed_)
+        error_ = error;
+
+    failed_ = true;
+    synced_.notify_all();
+}
+
+
+template <typename KeyT>
+std::error_code Journal<KeyT>::WriteBatch_(const std::vector<char>& records, std::size_t count)
+{
+    BatchHeader_ header = {BATCH_MAGIC, static_cast<std::uint32_t>(count), Checksum_(records.data(), records.size())};
+
+    // one write for header and records, a torn one fails the checksum
+    std::vector<char> frame(sizeof(header) + records.size());
+
+    std::memcpy(frame.data(), &header, sizeof(header));
+    std::memcpy(frame.data() + sizeof(header), records.data(), records.size());
+
+    if (FileIO::WriteAll(fd_, frame.data(), frame.size()) && ::fdatasync(fd_) == 0)
+        return {};
+
+    return FileIO::LastError();
+}
+
+
+template <typename KeyT>
+template <typename Fn>
+std::optional<std::size_t> Journal<KeyT>::Scan_(int fd, std::error_code& error, Fn&& on_record)
+{
+    FileHeader_ header   = {};
+    FileHeader_ expected = MakeHeader_();
+
+    struct stat info = {};
+
+    if (::fstat(fd, &info) != 0)
+    {
+        error = FileIO::LastError();
+        return std::nullopt;
+    }
+
+    std::size_t file_size = static_cast<std::size_t>(info.st_size);
+
+    if (file_size < sizeof(header))
+    {
+        error = FileIO::Error::WRONG_FORMAT;
+        return std::nullopt;
+    }
+
+    if (::lseek(fd, 0, SEEK_SET) != 0 || !FileIO::ReadAll(fd, &header, sizeof(header)))
+    {
+        error = FileIO::LastError();
+        return std::nullopt;
+    }
+
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0)
+    {
+        error = FileIO::Error::WRONG_FORMAT;
+        return std::nullopt;
+    }
+
+    std::size_t       end     = sizeof(header);
+    std::vector<char> records = {};
+    BatchHeader_      batch   = {};
+
+    // the sizes are checked before every read, so a failed read is an I/O error, not a torn tail
+    while (file_size - end >= sizeof(batch))
+    {
+        if (!FileIO::ReadAll(fd, &batch, sizeof(batch)))
+        {
+            error = FileIO::LastError();
+            return std::nullopt;
+        }
+
+        std::size_t bytes = std::size_t(batch.records) * RECORD_SIZE;
+
+        if (batch.magic != BATCH_MAGIC || bytes > file_size - end - sizeof(batch))
+            break;
+
+        records.resize(bytes);
+
+        if (!FileIO::ReadAll(fd, records.data(), bytes))
+        {
+            error = FileIO::LastError();
+            return std::nullopt;
+        }
+
+        if (Checksum_(records.data(), bytes) != batch.checksum)
+            break;
+
+        for (std::size_t pos = 0; pos < bytes; pos += RECORD_SIZE)
+        {
+            KeyT key;
+            std::memcpy(&key, records.data() + pos + 1, sizeof(KeyT));
+
+            on_record(static_cast<Op>(records[pos]), key);
+        }
+
+        end += sizeof(batch) + bytes;
+    }
+
+    return end;
+}
+
+
+template <typename KeyT>
+template <typename Comp, typename Alloc>
+std::optional<std::size_t> Journal<KeyT>::Replay(const std::string& path, Tree<KeyT, Comp, Alloc>& tree, std::error_code& error)
+{
+    using TreeT = Tree<KeyT, Comp, Alloc>;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        error = FileIO::LastError();
+        return std::nullopt;
+    }
+
+    std::vector<std::pair<KeyT, Op>> records;
+
+    std::optional<std::size_t> intact = Scan_(fd, error, [&](Op op, const KeyT& key) { records.emplace_back(key, op); });
+
+    ::close(fd);
+
+    if (!intact)
+        return std::nullopt;
+
+    // a stable sort keeps the records of one key in journal order, the last one wins
+    Comp comp = tree.key_comp();
+
+    std::stable_sort(records.begin(), records.end(), [&](const auto& lhs, const auto& rhs) { return comp(rhs.first, lhs.first); });
+
+    std::vector<KeyT> inserted;
+    std::vector<KeyT> erased;
+
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+        if (i + 1 < records.size() && !comp(records[i + 1].first, records[i].first))
+            continue;
+
+        (records[i].second == Op::ERASE ? erased : inserted).push_back(records[i].first);
+    }
+
+    // both lists are sorted and unique, so the trees are built in linear time
+    if (!erased.empty())
+        tree = TreeT::Difference(std::move(tree), TreeT(erased.begin(), erased.end()));
+
+    if (!inserted.empty())
+        tree = TreeT::Union(std::move(tree), TreeT(inserted.begin(), inserted.end()));
+
+    error.clear();
+    return records.size();
+}
+
+
+template <typename KeyT>
+typename Journal<KeyT>::FileHeader_ Journal<KeyT>::MakeHeader_()
+{
+    FileHeader_ header = {};
+
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.key_size   = sizeof(KeyT);
+    header.byte_order = BYTE_ORDER_MARK;
+
+    return header;
+}
+
+
+// 64-bit FNV-1a
+template <typename KeyT>
+std::uint64_t Journal<KeyT>::Checksum_(const char* data, std::size_t bytes)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (std::size_t i = 0; i < bytes; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+std::optional<DurableTree<KeyT, Comp, Alloc>> DurableTree<KeyT, Comp, Alloc>::Open(const std::string& snapshot_path,
+                                                                                  const std::string& journal_path,
+                                                                                  std::error_code& error,
+                                                                                  const JournalOptions& options)
+{
+    std::optional<Tree> tree = (::access(snapshot_path.c_str(), F_OK) == 0) ? Tree::Load(snapshot_path, error) : std::optional<Tree>(Tree());
+
+    if (!tree)
+        return std::nullopt;
+
+    if (::access(journal_path.c_str(), F_OK) == 0 && !Journal<KeyT>::Replay(journal_path, *tree, error))
+        return std::nullopt;
+
+    std::unique_ptr<Journal<KeyT>> journal = Journal<KeyT>::Open(journal_path, error, options);
+
+    if (!journal)
+        return std::nullopt;
+
+    return DurableTree(std::move(*tree), std::move(journal), snapshot_path);
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+bool DurableTree<KeyT, Comp, Alloc>::insert(const KeyT& key)
+{
+    std::size_t old_size = tree_.size();
+
+    tree_.insert(key);
+
+    if (tree_.size() == old_size)
+        return false;
+
+    journal_->Append(Op::INSERT, key);
+    return true;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+bool DurableTree<KeyT, Comp, Alloc>::erase(const KeyT& key)
+{
+    std::size_t old_size = tree_.size();
+
+    tree_.erase(key);
+
+    if (tree_.size() == old_size)
+        return false;
+
+    journal_->Append(Op::ERASE, key);
+    return true;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+std::size_t DurableTree<KeyT, Comp, Alloc>::InsertBatch(std::span<const KeyT> batch)
+{
+    std::size_t added = tree_.InsertBatch(batch);
+
+    // replaying keys that were already present changes nothing
+    if (added != 0)
+        journal_->Append(Op::INSERT, batch);
+
+    return added;
+}
+
+
+// Save returns once the snapshot and the rename are on disk, so the journal is never emptied
+// while a crash could still bring back the previous snapshot
+template <typename KeyT, typename Comp, typename Alloc>
+bool DurableTree<KeyT, Comp, Alloc>::Checkpoint(std::error_code& error)
+{
+    if (!journal_->Sync() || !tree_.Save(snapshot_path_, error) || !journal_->Reset())
+    {
+        if (journal_->Failed())
+            error = journal_->Error();
+
+        return false;
+    }
+
+    error.clear();
+    return true;
+}
+
+}
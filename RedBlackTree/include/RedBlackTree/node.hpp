@@ -1,5 +1,14 @@
 #pragma once
 
+#include <cstddef>
+#include <utility>
+
+// RBT_THREADED=1 keeps in-order neighbour links in every node, so stepping an iterator
+// is one pointer hop instead of a climb over fathers; every node grows by two pointers
+#ifndef RBT_THREADED
+#   define RBT_THREADED 0
+#endif
+
 namespace Trees::RBT {
 
 enum class NodeColor { RED, BLACK };
@@ -13,21 +22,43 @@ public:
                                                        RBTNode* father_ptr = nullptr)
         : key    (key_ref   )
         , color  (node_color)
+        , size   (1         )
         , left   (left_ptr  )
         , right  (right_ptr )
         , father (father_ptr)
     {}
 
-    RBTNode() : RBTNode({}, NodeColor::BLACK) {}
+    // constructs the key in place from args, the node starts red and unlinked
+    template <typename... Args>
+    explicit RBTNode(std::in_place_t, Args&&... args)
+        : key    (std::forward<Args>(args)...)
+        , color  (NodeColor::RED)
+        , size   (1      )
+        , left   (nullptr)
+        , right  (nullptr)
+        , father (nullptr)
+    {}
+
+    RBTNode() : RBTNode({}, NodeColor::BLACK) { size = 0; }
+
+    // links point into one tree, a copy would share them
+    RBTNode(const RBTNode&)            = delete;
+    RBTNode& operator=(const RBTNode&) = delete;
 
-    KeyT      key;
-    NodeColor color;
+    KeyT        key;
+    NodeColor   color;
+    std::size_t size;       // number of keys in the subtree rooted here, nil has 0
 
     RBTNode*  left;
     RBTNode*  right;
     RBTNode*  father;
 
+#if RBT_THREADED
+    RBTNode*  prev = nullptr;   // in-order neighbours, nil at the ends
+    RBTNode*  next = nullptr;
+#endif
+
 private:
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Trees::RBT::Parallel {
+
+inline std::size_t HardwareThreads()
+{
+    std::size_t threads = std::thread::hardware_concurrency();
+
+    return threads == 0 ? 1 : threads;
+}
+
+
+// Sorts [first, last) with up to `threads` threads: every thread sorts its own
+// slice, then neighbouring slices are merged pairwise, also in parallel.
+template <typename RandomIt, typename Less>
+void Sort(RandomIt first, RandomIt last, Less less, std::size_t threads = HardwareThreads())
+{
+    static constexpr std::size_t MIN_SLICE = 1 << 15;
+
+    std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+
+    threads = std::min(threads, count / MIN_SLICE);
+
+    if (threads <= 1)
+    {
+        std::sort(first, last, less);
+        return;
+    }
+
+    std::vector<RandomIt> bounds(threads + 1);
+
+    for (std::size_t i = 0; i <= threads; ++i)
+        bounds[i] = first + static_cast<std::ptrdiff_t>(count * i / threads);
+
+    std::vector<std::thread> workers;
+
+    for (std::size_t i = 0; i < threads; ++i)
+        workers.emplace_back([&, i] { std::sort(bounds[i], bounds[i + 1], less); });
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    for (std::size_t step = 1; step < threads; step *= 2)
+    {
+        workers.clear();
+
+        for (std::size_t i = 0; i + step < threads; i += 2 * step)
+        {
+            RandomIt begin  = bounds[i];
+            RandomIt middle = bounds[i + step];
+            RandomIt end    = bounds[std::min(i + 2 * step, threads)];
+
+            workers.emplace_back([=] { std::inplace_merge(begin, middle, end, less); });
+        }
+
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+}
+
+
+
+// Runs `left` on another thread and `right` on the calling one, returns when both are done.
+// Recursive algorithms fork only near the top of the recursion to keep the number of threads bounded.
+template <typename Left, typename Right>
+void ForkJoin(Left&& left, Right&& right)
+{
+    std::future<void> forked = std::async(std::launch::async, std::forward<Left>(left));
+
+    right();
+    forked.get();
+}
+
+// recursion depth up to which forking still gives every hardware thread some work, 0 on one thread
+inline unsigned ForkDepth()
+{
+    std::size_t threads = HardwareThreads();
+
+    return (threads == 1) ? 0 : static_cast<unsigned>(std::bit_width(threads - 1)) + 1;
+}
+
+
+// Fixed set of worker threads for repeated short parallel loops, so every loop
+// does not pay for starting threads. The calling thread works too.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(std::size_t threads = HardwareThreads())
+    {
+        for (std::size_t i = 1; i < threads; ++i)
+            workers_.emplace_back([this] { WorkerLoop_(); });
+    }
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+
+        wake_.notify_all();
+
+        for (std::thread& worker : workers_)
+            worker.join();
+    }
+
+    std::size_t Size() const { return workers_.size() + 1; }
+
+    // calls body(begin, end) on disjoint slices covering [0, count) and returns when all are done,
+    // loops shorter than two slices run on the calling thread only
+    template <typename Body>
+    void ParallelFor(std::size_t count, Body&& body, std::size_t min_slice = 1024)
+    {
+        min_slice = std::max<std::size_t>(min_slice, 1);
+
+        if (workers_.empty() || count < 2 * min_slice)
+        {
+            if (count != 0)
+                body(std::size_t{0}, count);
+
+            return;
+        }
+
+        // a few slices per thread even out uneven slices
+        std::size_t slices = std::min(count / min_slice, Size() * 4);
+
+        std::function<void(std::size_t)> run_slice = [&](std::size_t slice)
+        {
+            body(count * slice / slices, count * (slice + 1) / slices);
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            job_        = &run_slice;
+            slices_     = slices;
+            next_slice_ = 0;
+            busy_       = workers_.size();
+            ++generation_;
+        }
+
+        wake_.notify_all();
+
+        RunSlices_();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return busy_ == 0; });
+
+        job_ = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers_ = {};
+
+    std::mutex              mutex_ = {};
+    std::condition_variable wake_  = {};
+    std::condition_variable done_  = {};
+
+    const std::function<void(std::size_t)>* job_        = nullptr;
+    std::size_t                             slices_     = 0;
+    std::atomic<std::size_t>                next_slice_ = 0;
+    std::size_t                             busy_       = 0;
+    std::size_t                             generation_ = 0;
+    bool                                    stop_       = false;
+
+    void RunSlices_()
+    {
+        for (std::size_t slice = next_slice_++; slice < slices_; slice = next_slice_++)
+            (*job_)(slice);
+    }
+
+    void WorkerLoop_()
+    {
+        std::size_t seen_generation = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+
+                if (stop_)
+                    return;
+
+                seen_generation = generation_;
+            }
+
+            RunSlices_();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (--busy_ == 0)
+                done_.notify_one();
+        }
+    }
+};
+
+}
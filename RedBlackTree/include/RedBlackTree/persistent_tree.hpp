@@ -0,0 +1,543 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "RedBlackTree/node.hpp"
+#include "RedBlackTree/trace.hpp"
+
+namespace Trees::RBT {
+
+// Red-black tree with immutable, reference counted nodes and no father links.
+// insert and erase copy only the nodes on their path (split the tree at the key,
+// then join the halves back), every other node is shared with older versions.
+// Snapshot() is O(1): it takes one more reference to the current root, and a version
+// is freed once the last snapshot holding it is gone.
+
+template <typename KeyT>
+struct PersistentNode
+{
+    using Ptr = std::shared_ptr<const PersistentNode>;
+
+    KeyT          key;
+    Ptr           left;
+    Ptr           right;
+    std::size_t   size;             // number of keys in the subtree
+    std::uint8_t  black_height;     // black nodes on a path down from here, empty subtree has 0
+    NodeColor     color;
+
+    static Ptr Make(NodeColor color, Ptr left, const KeyT& key, Ptr right)
+    {
+        RBT_ASSERT(BlackHeight(left) == BlackHeight(right));
+
+        std::size_t  size         = Size(left) + Size(right) + 1;
+        std::uint8_t black_height = static_cast<std::uint8_t>(BlackHeight(left) + (color == NodeColor::BLACK ? 1 : 0));
+
+        return std::make_shared<const PersistentNode>(PersistentNode{key, std::move(left), std::move(right),
+                                                                     size, black_height, color});
+    }
+
+    static std::size_t  Size       (const Ptr& node) { return node ? node->size         : 0; }
+    static std::uint8_t BlackHeight(const Ptr& node) { return node ? node->black_height : 0; }
+    static NodeColor    Color      (const Ptr& node) { return node ? node->color        : NodeColor::BLACK; }
+};
+
+
+// In-order iterator over one version. It keeps the path of pending ancestors instead
+// of climbing father links, and stays valid while the snapshot it came from is alive.
+template <typename KeyT>
+class PersistentIterator
+{
+    template <typename K, typename C>
+    friend class PersistentSnapshot;
+
+    using Node = PersistentNode<KeyT>;
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = KeyT;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const KeyT*;
+    using reference         = const KeyT&;
+
+    PersistentIterator() = default;
+
+    const KeyT& operator*()  const { return path_.back()->key; }
+    const KeyT* operator->() const { return &path_.back()->key; }
+
+    PersistentIterator& operator++()
+    {
+        const Node* cur_node = path_.back();
+        path_.pop_back();
+
+        PushLeftSpine_(cur_node->right.get());
+
+        return *this;
+    }
+
+    PersistentIterator operator++(int)
+    {
+        PersistentIterator temp = *this;
+        ++(*this);
+        return temp;
+    }
+
+    bool operator==(const PersistentIterator& other) const { return get() == other.get(); }
+    bool operator!=(const PersistentIterator& other) const { return get() != other.get(); }
+
+    const Node* get() const { return path_.empty() ? nullptr : path_.back(); }
+
+private:
+    std::vector<const Node*> path_ = {};    // the current node on top, then the ancestors still to visit
+
+    void PushLeftSpine_(const Node* node)
+    {
+        for (; node != nullptr; node = node->left.get())
+            path_.push_back(node);
+    }
+};
+
+
+// Read-only view of one version of a PersistentTree.
+template <typename KeyT, typename Comp>
+class PersistentSnapshot
+{
+    template <typename K, typename C>
+    friend class PersistentTree;
+
+    using Node    = PersistentNode<KeyT>;
+    using NodePtr = typename Node::Ptr;
+
+public:
+    using const_iterator = PersistentIterator<KeyT>;
+    using iterator       = const_iterator;
+
+    PersistentSnapshot() = default;
+
+    const_iterator begin() const;
+    const_iterator end  () const { return const_iterator(); }
+
+    const_iterator find      (const KeyT& key) const;
+    const_iterator LowerBound(const KeyT& key) const { return Bound_(key, false); }   // first not less then key
+    const_iterator UpperBound(const KeyT& key) const { return Bound_(key, true);  }   // first greater  then key
+
+    std::size_t size () const { return Node::Size(root_); }
+    bool        empty() const { return root_ == nullptr; }
+
+    std::size_t Rank        (const KeyT& key) const { return CountBefore_(key, false); }    // number of keys less then key
+    std::size_t CountInRange(const KeyT& lo, const KeyT& hi) const;                         // number of keys in [lo, hi]
+
+    // red-black invariants, key order and the size and black height kept in every node
+    bool IsValid() const;
+
+private:
+    [[no_unique_address]] Comp comparator_ = {};
+    NodePtr root_ = nullptr;
+
+    PersistentSnapshot(NodePtr root, const Comp& comparator) : comparator_(comparator), root_(std::move(root)) {}
+
+    bool Before_(const KeyT& lhs, const KeyT& rhs) const { return comparator_(rhs, lhs); }
+
+    const_iterator Bound_       (const KeyT& key, bool inclusive) const;
+    std::size_t    CountBefore_ (const KeyT& key, bool inclusive) const;
+    int            ValidSubtree_(const Node* sub_root, const KeyT*& prev) const;     // black height, -1 if broken
+};
+
+
+template <typename KeyT, typename Comp>
+class PersistentTree
+{
+    using Node    = PersistentNode<KeyT>;
+    using NodePtr = typename Node::Ptr;
+
+public:
+    using Snapshot_t = PersistentSnapshot<KeyT, Comp>;
+
+    PersistentTree() = default;
+
+    template <std::input_iterator InputIt>
+    PersistentTree(InputIt first, InputIt last);
+
+    PersistentTree(const PersistentTree&)            = delete;
+    PersistentTree& operator=(const PersistentTree&) = delete;
+
+    // writers are serialized with each other, but never wait for readers
+    bool insert(const KeyT& key);       // false if the key was already there
+    bool erase (const KeyT& key);       // false if there was no such key
+
+    // O(1) immutable view of the current version, may be called from any thread
+    Snapshot_t Snapshot() const;
+
+    std::size_t size() const { return Snapshot().size(); }
+
+private:
+    [[no_unique_address]] Comp comparator_ = {};
+
+    std::mutex         write_mutex_ = {};   // one writer at a time
+    mutable std::mutex root_mutex_  = {};   // guards root_ between the writer publishing and Snapshot()
+    NodePtr            root_        = nullptr;
+
+    struct Split_
+    {
+        NodePtr left;
+        NodePtr right;
+        bool    found;
+    };
+
+    bool Before_(const KeyT& lhs, const KeyT& rhs) const { return comparator_(rhs, lhs); }
+
+    void Publish_(NodePtr new_root);
+
+    Split_  SplitAt_   (const NodePtr& sub_root, const KeyT& key) const;
+    NodePtr SplitLast_ (const NodePtr& sub_root, KeyT& last) const;
+    NodePtr Join2_     (const NodePtr& left, const NodePtr& right) const;
+
+    static NodePtr Join_     (NodePtr left, const KeyT& key, NodePtr right);
+    static NodePtr JoinRight_(const NodePtr& left, const KeyT& key, const NodePtr& right);
+    static NodePtr JoinLeft_ (const NodePtr& left, const KeyT& key, const NodePtr& right);
+    static NodePtr Blacken_  (const NodePtr& node);
+
+    static NodePtr Build_(const std::vector<KeyT>& keys, std::size_t first, std::size_t count, unsigned depth, unsigned red_depth);
+};
+
+
+//--- PersistentSnapshot -------------------------------------------------------
+
+template <typename KeyT, typename Comp>
+PersistentSnapshot<KeyT, Comp>::const_iterator PersistentSnapshot<KeyT, Comp>::begin() const
+{
+    const_iterator result;
+    result.PushLeftSpine_(root_.get());
+
+    return result;
+}
+
+template <typename KeyT, typename Comp>
+PersistentSnapshot<KeyT, Comp>::const_iterator PersistentSnapshot<KeyT, Comp>::find(const KeyT& key) const
+{
+    const_iterator result = LowerBound(key);
+
+    if (result != end() && Before_(key, *result))
+        return end();
+
+    return result;
+}
+
+// the ancestors where the descent went left are exactly the keys still to visit after the bound
+template <typename KeyT, typename Comp>
+PersistentSnapshot<KeyT, Comp>::const_iterator PersistentSnapshot<KeyT, Comp>::Bound_(const KeyT& key, bool inclusive) const
+{
+    const_iterator result;
+
+    for (const Node* cur_node = root_.get(); cur_node != nullptr; )
+    {
+        bool goes_left = inclusive ? Before_(key, cur_node->key) : !Before_(cur_node->key, key);
+
+        if (goes_left)
+        {
+            result.path_.push_back(cur_node);
+            cur_node = cur_node->left.get();
+        }
+
+        else
+        {
+            cur_node = cur_node->right.get();
+        }
+    }
+
+    return result;
+}
+
+template <typename KeyT, typename Comp>
+std::size_t PersistentSnapshot<KeyT, Comp>::CountBefore_(const KeyT& key, bool inclusive) const
+{
+    std::size_t count = 0;
+
+    for (const Node* cur_node = root_.get(); cur_node != nullptr; )
+    {
+        bool goes_left = inclusive ? Before_(key, cur_node->key) : !Before_(cur_node->key, key);
+
+        if (goes_left)
+        {
+            cur_node = cur_node->left.get();
+        }
+
+        else
+        {
+            count   += Node::Size(cur_node->left) + 1;
+            cur_node = cur_node->right.get();
+        }
+    }
+
+    return count;
+}
+
+template <typename KeyT, typename Comp>
+std::size_t PersistentSnapshot<KeyT, Comp>::CountInRange(const KeyT& lo, const KeyT& hi) const
+{
+    if (Before_(hi, lo))
+        return 0;
+
+    return CountBefore_(hi, true) - CountBefore_(lo, false);
+}
+
+template <typename KeyT, typename Comp>
+bool PersistentSnapshot<KeyT, Comp>::IsValid() const
+{
+    const KeyT* prev = nullptr;
+
+    return Node::Color(root_) == NodeColor::BLACK && ValidSubtree_(root_.get(), prev) >= 0;
+}
+
+// in order, so prev is the previous key and the keys must grow strictly
+template <typename KeyT, typename Comp>
+int PersistentSnapshot<KeyT, Comp>::ValidSubtree_(const Node* sub_root, const KeyT*& prev) const
+{
+    if (sub_root == nullptr)
+        return 0;
+
+    const NodePtr& left  = sub_root->left;
+    const NodePtr& right = sub_root->right;
+
+    if (sub_root->color == NodeColor::RED && (Node::Color(left) == NodeColor::RED || Node::Color(right) == NodeColor::RED))
+        return -1;
+
+    if (sub_root->size != Node::Size(left) + Node::Size(right) + 1)
+        return -1;
+
+    int left_height = ValidSubtree_(left.get(), prev);
+
+    if (left_height < 0 || (prev != nullptr && !Before_(*prev, sub_root->key)))
+        return -1;
+
+    prev = &sub_root->key;
+
+    int right_height = ValidSubtree_(right.get(), prev);
+
+    if (right_height != left_height)
+        return -1;
+
+    int black_height = left_height + (sub_root->color == NodeColor::BLACK ? 1 : 0);
+
+    return black_height == sub_root->black_height ? black_height : -1;
+}
+
+
+//--- PersistentTree -----------------------------------------------------------
+
+template <typename KeyT, typename Comp>
+template <std::input_iterator InputIt>
+PersistentTree<KeyT, Comp>::PersistentTree(InputIt first, InputIt last)
+{
+    auto before = [this](const KeyT& lhs, const KeyT& rhs) { return Before_(lhs, rhs); };
+
+    std::vector<KeyT> keys(first, last);
+
+    std::sort(keys.begin(), keys.end(), before);
+    keys.erase(std::unique(keys.begin(), keys.end(), [&](const KeyT& lhs, const KeyT& rhs) { return !before(lhs, rhs); }),
+               keys.end());
+
+    if (keys.empty())
+        return;
+
+    // the same shape as Tree::BulkLoad: full levels black, the deepest one red
+    unsigned red_depth = static_cast<unsigned>(std::bit_width(keys.size()) - 1);
+
+    root_ = Blacken_(Build_(keys, 0, keys.size(), 0, red_depth));
+}
+
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::Snapshot_t PersistentTree<KeyT, Comp>::Snapshot() const
+{
+    std::lock_guard<std::mutex> lock(root_mutex_);
+
+    return Snapshot_t(root_, comparator_);
+}
+
+template <typename KeyT, typename Comp>
+void PersistentTree<KeyT, Comp>::Publish_(NodePtr new_root)
+{
+    {
+        std::lock_guard<std::mutex> lock(root_mutex_);
+        root_.swap(new_root);
+    }
+
+    // new_root now holds the old version, its unshared nodes are freed here, outside the lock
+}
+
+template <typename KeyT, typename Comp>
+bool PersistentTree<KeyT, Comp>::insert(const KeyT& key)
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    Split_ parts = SplitAt_(root_, key);
+
+    if (parts.found)
+        return false;
+
+    Publish_(Join_(std::move(parts.left), key, std::move(parts.right)));
+
+    return true;
+}
+
+template <typename KeyT, typename Comp>
+bool PersistentTree<KeyT, Comp>::erase(const KeyT& key)
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    Split_ parts = SplitAt_(root_, key);
+
+    if (!parts.found)
+        return false;
+
+    Publish_(Join2_(parts.left, parts.right));
+
+    return true;
+}
+
+// keys less then key go left, greater go right, the equal node (if any) is dropped
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::Split_ PersistentTree<KeyT, Comp>::SplitAt_(const NodePtr& sub_root, const KeyT& key) const
+{
+    if (!sub_root)
+        return {nullptr, nullptr, false};
+
+    if (Before_(key, sub_root->key))
+    {
+        Split_ parts = SplitAt_(sub_root->left, key);
+        parts.right  = Join_(std::move(parts.right), sub_root->key, sub_root->right);
+
+        return parts;
+    }
+
+    if (Before_(sub_root->key, key))
+    {
+        Split_ parts = SplitAt_(sub_root->right, key);
+        parts.left   = Join_(sub_root->left, sub_root->key, std::move(parts.left));
+
+        return parts;
+    }
+
+    return {sub_root->left, sub_root->right, true};
+}
+
+// returns the subtree without its maximum, which is stored to last
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::NodePtr PersistentTree<KeyT, Comp>::SplitLast_(const NodePtr& sub_root, KeyT& last) const
+{
+    if (!sub_root->right)
+    {
+        last = sub_root->key;
+        return sub_root->left;
+    }
+
+    NodePtr rest = SplitLast_(sub_root->right, last);
+
+    return Join_(sub_root->left, sub_root->key, std::move(rest));
+}
+
+// every key of left is less then key, every key of right is greater
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::NodePtr PersistentTree<KeyT, Comp>::Join_(NodePtr left, const KeyT& key, NodePtr right)
+{
+    left  = Blacken_(left);
+    right = Blacken_(right);
+
+    if (Node::BlackHeight(left) > Node::BlackHeight(right))
+        return Blacken_(JoinRight_(left, key, right));
+
+    if (Node::BlackHeight(left) < Node::BlackHeight(right))
+        return Blacken_(JoinLeft_(left, key, right));
+
+    return Node::Make(NodeColor::BLACK, std::move(left), key, std::move(right));
+}
+
+// walks down the right spine of the taller left tree to the first black node of right's
+// black height and hangs key with right there; the result has left's black height and at
+// most one red-red pair at its root, which the caller above (or Join_) repairs
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::NodePtr PersistentTree<KeyT, Comp>::JoinRight_(const NodePtr& left, const KeyT& key, const NodePtr& right)
+{
+    if (Node::Color(left) == NodeColor::BLACK && Node::BlackHeight(left) == Node::BlackHeight(right))
+        return Node::Make(NodeColor::RED, left, key, right);
+
+    NodePtr new_right = JoinRight_(left->right, key, right);
+
+    if (left->color == NodeColor::BLACK && Node::Color(new_right) == NodeColor::RED
+                                        && Node::Color(new_right->right) == NodeColor::RED)
+    {
+        // rotate left and recolor
+        NodePtr new_left = Node::Make(NodeColor::BLACK, left->left, left->key, new_right->left);
+
+        return Node::Make(NodeColor::RED, std::move(new_left), new_right->key, Blacken_(new_right->right));
+    }
+
+    return Node::Make(left->color, left->left, left->key, std::move(new_right));
+}
+
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::NodePtr PersistentTree<KeyT, Comp>::JoinLeft_(const NodePtr& left, const KeyT& key, const NodePtr& right)
+{
+    if (Node::Color(right) == NodeColor::BLACK && Node::BlackHeight(right) == Node::BlackHeight(left))
+        return Node::Make(NodeColor::RED, left, key, right);
+
+    NodePtr new_left = JoinLeft_(left, key, right->left);
+
+    if (right->color == NodeColor::BLACK && Node::Color(new_left) == NodeColor::RED
+                                         && Node::Color(new_left->left) == NodeColor::RED)
+    {
+        // rotate right and recolor
+        NodePtr new_right = Node::Make(NodeColor::BLACK, new_left->right, right->key, right->right);
+
+        return Node::Make(NodeColor::RED, Blacken_(new_left->left), new_left->key, std::move(new_right));
+    }
+
+    return Node::Make(right->color, std::move(new_left), right->key, right->right);
+}
+
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::NodePtr PersistentTree<KeyT, Comp>::Join2_(const NodePtr& left, const NodePtr& right) const
+{
+    if (!left)
+        return right;
+
+    KeyT    last = left->key;
+    NodePtr rest = SplitLast_(left, last);
+
+    return Join_(std::move(rest), last, right);
+}
+
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::NodePtr PersistentTree<KeyT, Comp>::Blacken_(const NodePtr& node)
+{
+    if (Node::Color(node) == NodeColor::BLACK)
+        return node;
+
+    return Node::Make(NodeColor::BLACK, node->left, node->key, node->right);
+}
+
+template <typename KeyT, typename Comp>
+PersistentTree<KeyT, Comp>::NodePtr PersistentTree<KeyT, Comp>::Build_(const std::vector<KeyT>& keys, std::size_t first,
+                                                                       std::size_t count, unsigned depth, unsigned red_depth)
+{
+    if (count == 0)
+        return nullptr;
+
+    std::size_t middle = count / 2;
+
+    NodePtr left  = Build_(keys, first,              middle,             depth + 1, red_depth);
+    NodePtr right = Build_(keys, first + middle + 1, count - middle - 1, depth + 1, red_depth);
+
+    NodeColor color = (depth == red_depth) ? NodeColor::RED : NodeColor::BLACK;
+
+    return Node::Make(color, std::move(left), keys[first + middle], std::move(right));
+}
+
+}
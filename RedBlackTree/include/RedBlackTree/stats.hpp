@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// RBT_STATS=1 makes every Tree count its hot-path events, see Tree::Stats(). The counters
+// are relaxed atomics, so const lookups running in several threads may count at once.
+// With the default 0 there are no counters and RBT_STAT compiles to nothing.
+#ifndef RBT_STATS
+#   define RBT_STATS 0
+#endif
+
+namespace Trees::RBT {
+
+// counters of one tree since its construction or the last ResetStats()
+struct TreeStats
+{
+    std::uint64_t comparisons             = 0;  // comparator calls
+    std::uint64_t left_rotations          = 0;
+    std::uint64_t right_rotations         = 0;
+    std::uint64_t insert_fixups           = 0;  // red-red fixups, one per linked new node
+    std::uint64_t insert_fixup_iterations = 0;  // their loop turns
+    std::uint64_t delete_fixups           = 0;  // double-black fixups, one per unlinked black node
+    std::uint64_t delete_fixup_iterations = 0;  // their loop turns
+    std::uint64_t descents                = 0;  // root-to-leaf searches of lookups and inserts
+    std::uint64_t descent_nodes           = 0;  // nodes visited by them, the sum of search path lengths
+    std::uint64_t climbs                  = 0;  // steps to a father made by iterators and neighbour lookups
+};
+
+#if RBT_STATS
+
+class StatCounters
+{
+public:
+    StatCounters() = default;
+
+    // a copied or moved tree starts counting from zero
+    StatCounters(const StatCounters&)            {}
+    StatCounters& operator=(const StatCounters&) { return *this; }
+
+    std::atomic<std::uint64_t> comparisons             {0};
+    std::atomic<std::uint64_t> left_rotations          {0};
+    std::atomic<std::uint64_t> right_rotations         {0};
+    std::atomic<std::uint64_t> insert_fixups           {0};
+    std::atomic<std::uint64_t> insert_fixup_iterations {0};
+    std::atomic<std::uint64_t> delete_fixups           {0};
+    std::atomic<std::uint64_t> delete_fixup_iterations {0};
+    std::atomic<std::uint64_t> descents                {0};
+    std::atomic<std::uint64_t> descent_nodes           {0};
+    std::atomic<std::uint64_t> climbs                  {0};
+
+    TreeStats Snapshot() const
+    {
+        auto load = [](const std::atomic<std::uint64_t>& counter) { return counter.load(std::memory_order_relaxed); };
+
+        return {load(comparisons), load(left_rotations), load(right_rotations),
+                load(insert_fixups), load(insert_fixup_iterations),
+                load(delete_fixups), load(delete_fixup_iterations),
+                load(descents), load(descent_nodes), load(climbs)};
+    }
+
+    void Reset()
+    {
+        for (std::atomic<std::uint64_t>* counter : {&comparisons, &left_rotations, &right_rotations,
+                                                    &insert_fixups, &insert_fixup_iterations,
+                                                    &delete_fixups, &delete_fixup_iterations,
+                                                    &descents, &descent_nodes, &climbs})
+            counter->store(0, std::memory_order_relaxed);
+    }
+};
+
+#   define RBT_STAT(counter) (stats_.counter.fetch_add(1, std::memory_order_relaxed))
+#else
+#   define RBT_STAT(counter) ((void)0)
+#endif
+
+}
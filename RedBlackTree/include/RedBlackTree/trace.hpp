@@ -0,0 +1,33 @@
+#pragma once
+
+#include "RLogSU/error_handler.hpp"
+#include "RLogSU/logger.hpp"
+
+// Compile-time tracing level of the tree code (RBT_TRACE_LEVEL cmake option):
+//   0 - no logging and no checks, every macro below compiles to nothing (default with NDEBUG);
+//   1 - assertions, warnings and ERROR_HANDLE;
+//   2 - plus per-step RLSU_INFO tracing (default without NDEBUG).
+
+#ifndef RBT_TRACE_LEVEL
+#   ifdef NDEBUG
+#       define RBT_TRACE_LEVEL 0
+#   else
+#       define RBT_TRACE_LEVEL 2
+#   endif
+#endif
+
+#if RBT_TRACE_LEVEL >= 2
+#   define RBT_INFO(...) RLSU_INFO(__VA_ARGS__)
+#else
+#   define RBT_INFO(...) ((void)0)
+#endif
+
+#if RBT_TRACE_LEVEL >= 1
+#   define RBT_ASSERT(...)  RLSU_ASSERT(__VA_ARGS__)
+#   define RBT_WARNING(...) RLSU_WARNING(__VA_ARGS__)
+#   define RBT_HANDLE(...)  ERROR_HANDLE(__VA_ARGS__)
+#else
+#   define RBT_ASSERT(...)  ((void)0)
+#   define RBT_WARNING(...) ((void)0)
+#   define RBT_HANDLE(...)  __VA_ARGS__
+#endif
@@ -1,15 +1,32 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-#include "RLogSU/error_handler.hpp"
 #include "RLogSU/graph_appearance.hpp"
-#include "RLogSU/logger.hpp"
+#include "RedBlackTree/arena.hpp"
 #include "RedBlackTree/node.hpp"
 #include "RedBlackTree/iterator.hpp"
+#include "RedBlackTree/parallel.hpp"
+#include "RedBlackTree/stats.hpp"
+#include "RedBlackTree/trace.hpp"
 #include "RLogSU/graph.hpp"
 
+// RBT_PREFETCH=0 drops the software prefetches of the descent kernel, to measure what they give
+#ifndef RBT_PREFETCH
+#   define RBT_PREFETCH 1
+#endif
+
 namespace Trees::RBT {
 
 // namespace
@@ -20,19 +37,33 @@ namespace Trees::RBT {
 //         std::is_same_v<It, ConstIterator>;
 // }
 
+// Comp marked with is_transparent (like std::greater<>) lets lookups take any type it compares with KeyT
+template <typename Comp>
+concept TransparentComparator = requires { typename Comp::is_transparent; };
+
 template <typename KeyT, typename Comp>
+class FrozenTree;
+
+template <typename KeyT, typename Comp, typename Alloc = ArenaAllocator<KeyT>>
 class Tree
 {
 public:
     Tree();
+    explicit Tree(const Alloc& alloc);
+
+    template <std::input_iterator InputIt>
+    Tree(InputIt first, InputIt last, const Alloc& alloc = Alloc());
     Tree(const Tree& other);
     Tree(Tree&& other);
     Tree& operator=(const Tree& other);
     Tree& operator=(Tree&& other);
     ~Tree();
     
-    typedef RBTIterator<KeyT, Comp, KeyT>       iterator;
-    typedef RBTIterator<KeyT, Comp, const KeyT> const_iterator;
+    typedef RBTIterator<KeyT, Comp, Alloc, KeyT>       iterator;
+    typedef RBTIterator<KeyT, Comp, Alloc, const KeyT> const_iterator;
+
+    typedef std::reverse_iterator<iterator>            reverse_iterator;
+    typedef std::reverse_iterator<const_iterator>      const_reverse_iterator;
     
     friend iterator;
     friend const_iterator;
@@ -46,46 +77,304 @@ public:
     iterator       end  ()       { return CreateIterator (nil_); }
     const_iterator end  () const { return CreateIterator (nil_); }
 
+    reverse_iterator       rbegin()       { return reverse_iterator      (end()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+
+    reverse_iterator       rend  ()       { return reverse_iterator      (begin()); }
+    const_reverse_iterator rend  () const { return const_reverse_iterator(begin()); }
+
+    // minimum and maximum keys, the tree must not be empty
+    const KeyT&    front() const { RBT_ASSERT(root_ != nil_); return leftmost_ ->key; }
+    const KeyT&    back () const { RBT_ASSERT(root_ != nil_); return rightmost_->key; }
+
     iterator       find(const KeyT& key)       { return CreateIterator (FindInSubtree_(root_, key)); };
     const_iterator find(const KeyT& key) const { return CreateIterator (FindInSubtree_(root_, key)); };
 
-    iterator       insert(const KeyT& new_key);
+    template <typename K> requires TransparentComparator<Comp>
+    iterator       find(const K& key)          { return CreateIterator (FindInSubtree_(root_, key)); };
+    template <typename K> requires TransparentComparator<Comp>
+    const_iterator find(const K& key) const    { return CreateIterator (FindInSubtree_(root_, key)); };
+
+    iterator       insert(const KeyT& new_key) { return CreateIterator (InsertFrom_(root_, new_key).first); }
+    iterator       insert(KeyT&&      new_key) { return CreateIterator (InsertFrom_(root_, std::move(new_key)).first); }
+
+    // hint is the element that should follow new_key: a right hint saves the comparisons of the
+    // descent, but subtree sizes are still updated up to the root, so it is O(log n) either way
+    iterator       insert(const_iterator hint, const KeyT& new_key) { return emplace_hint(hint, new_key); }
+    iterator       insert(const_iterator hint, KeyT&&      new_key) { return emplace_hint(hint, std::move(new_key)); }
+
+    // builds the key inside a new node, the node is dropped if the key is already present
+    template <typename... Args>
+    iterator       emplace(Args&&... args);
+
+    template <typename... Args>
+    iterator       emplace_hint(const_iterator hint, Args&&... args);
+
+    // builds a node from key only when key is absent; K may be any type the comparator takes
+    // together with KeyT that KeyT can be built from
+    template <typename K>
+    std::pair<iterator, bool> try_emplace(K&& key);
+
+    // sorts the batch and starts every descent from the previously inserted node, returns the number of new keys
+    std::size_t    InsertBatch(std::span<const KeyT> batch);
 
     void           erase(iterator erase_it)     { DeleteNode_(erase_it.node_ptr_); }
     void           erase(const KeyT& erase_key) { DeleteNode_(FindInSubtree_(root_, erase_key)); }
 
-    iterator       LowerBound(const KeyT& key);// const;   // first not less then key
-    iterator       UpperBound(const KeyT& key);// const;   // first greater  then key
+    template <typename K> requires (TransparentComparator<Comp> && !std::is_convertible_v<const K&, const_iterator>)
+    void           erase(const K& erase_key)    { DeleteNode_(FindInSubtree_(root_, erase_key)); }
+
+    // whole intervals are cut out with two splits and a join, O(log n) plus freeing the removed nodes
+    iterator       erase(const_iterator first, const_iterator last);      // returns last
+    std::size_t    EraseRange  (const KeyT& lo, const KeyT& hi);          // removes keys in [lo, hi], returns their number
+    Tree           ExtractRange(const KeyT& lo, const KeyT& hi);          // moves keys in [lo, hi] into a tree with its own arena
+
+    // adds [first, last) in O(n + m) when the range is sorted and unique, otherwise after a parallel sort
+    template <std::input_iterator InputIt>
+    void           BulkLoad(InputIt first, InputIt last);
+
+    void           clear();
+
+    // set algebra on whole trees in O(log n) (split, join) and O(m log(n/m + 1)) (the rest):
+    // arguments are consumed, nodes are relinked instead of copied, the result takes the
+    // comparator of the first argument.
+    // Every tree returned here has an arena of its own that adopts the chunks of the arguments
+    // (Arena::Adopt), so the two halves of a split, or a result and an emptied argument, may be
+    // used on different threads. An allocator without Adopt is shared and must be thread safe.
+    std::pair<Tree, Tree> Split(const KeyT& key);                        // keys less then key and the rest, leaves the tree empty
+    static Tree    Join(Tree&& left, const KeyT& key, Tree&& right);      // every key of left < key < every key of right
+    static Tree    Join(Tree&& left, Tree&& right);                       // every key of left < every key of right
+
+    // recurse over both halves in parallel near the top, equal keys are taken from lhs
+    static Tree    Union       (Tree&& lhs, Tree&& rhs);
+    static Tree    Intersection(Tree&& lhs, Tree&& rhs);
+    static Tree    Difference  (Tree&& lhs, Tree&& rhs);                  // keys of lhs missing in rhs
+
+    iterator       LowerBound(const KeyT& key)       { return CreateIterator (LowerBoundNode_(key)); }   // first not less then key
+    iterator       UpperBound(const KeyT& key)       { return CreateIterator (UpperBoundNode_(key)); }   // first greater  then key
+
+    // const lookups only read the tree, any number of threads may run them while nobody modifies it
+    const_iterator LowerBound(const KeyT& key) const { return CreateIterator (LowerBoundNode_(key)); }
+    const_iterator UpperBound(const KeyT& key) const { return CreateIterator (UpperBoundNode_(key)); }
+
+    template <typename K> requires TransparentComparator<Comp>
+    iterator       LowerBound(const K& key)          { return CreateIterator (LowerBoundNode_(key)); }
+    template <typename K> requires TransparentComparator<Comp>
+    iterator       UpperBound(const K& key)          { return CreateIterator (UpperBoundNode_(key)); }
+    template <typename K> requires TransparentComparator<Comp>
+    const_iterator LowerBound(const K& key) const    { return CreateIterator (LowerBoundNode_(key)); }
+    template <typename K> requires TransparentComparator<Comp>
+    const_iterator UpperBound(const K& key) const    { return CreateIterator (UpperBoundNode_(key)); }
+
+    std::size_t    size () const { return root_->size; }
+    bool           empty() const { return root_ == nil_; }
+
+    Comp           key_comp() const { return comparator_; }
+
+    std::size_t    Rank        (const KeyT& key) const                 { return CountLess_(key); }             // number of keys less then key
+    std::size_t    CountInRange(const KeyT& lo, const KeyT& hi) const  { return CountInRange_(lo, hi); }       // number of keys in [lo, hi]
+
+    template <typename K> requires TransparentComparator<Comp>
+    std::size_t    Rank        (const K& key) const                    { return CountLess_(key); }
+    template <typename K> requires TransparentComparator<Comp>
+    std::size_t    CountInRange(const K& lo, const K& hi) const        { return CountInRange_(lo, hi); }
+
+    // many independent lookups at once: the descents of a group take turns level by level,
+    // so their cache misses overlap instead of following one another; results[i] answers keys[i]
+    void           FindBatch        (std::span<const KeyT> keys, std::span<const_iterator> results) const;
+    void           LowerBoundBatch  (std::span<const KeyT> keys, std::span<const_iterator> results) const;
+    void           CountInRangeBatch(std::span<const std::pair<KeyT, KeyT>> ranges, std::span<std::size_t> counts) const;
+
+    iterator       Select(std::size_t k)       { return CreateIterator (SelectNode_(k)); }   // k-th key counting from 0,
+    const_iterator Select(std::size_t k) const { return CreateIterator (SelectNode_(k)); }   // end() if k >= size()
+
+    // calls fn(key) for the keys in [lo, hi] in order: one descent with an explicit stack, no iterators
+    template <typename Fn>
+    void           ForEachInRange(const KeyT& lo, const KeyT& hi, Fn&& fn) const;
+
+    // on-disk copy in the FrozenTree layout, for trivially copyable keys: Open maps the file and
+    // answers lookups from the mapping without building nodes, Load rebuilds a mutable tree in O(n).
+    // Failures set error, see FrozenTree::Save and Open
+    bool           Save(const std::string& path, std::error_code& error) const;
+    static std::optional<FrozenTree<KeyT, Comp>> Open(const std::string& path, std::error_code& error);
+    static std::optional<Tree>                   Load(const std::string& path, std::error_code& error, const Alloc& alloc = Alloc());
+
+    // hot-path counters, all zero unless built with RBT_STATS=1
+    TreeStats      Stats() const;
+    void           ResetStats();
+#if RBT_STATS
+    void           DumpStats() const;                    // Stats() and DepthHistogram() through RLogSU
+#endif
+
+    // balance on real data: Height() <= 2 log2(n + 1) for n keys, and every path from the root
+    // down crosses BlackHeight() black nodes; the height and the histogram cost O(n)
+    std::size_t    Height() const                      { return DepthHistogram().size(); }
+    unsigned       BlackHeight() const                 { return BlackHeight_(root_); }
+    std::vector<std::size_t> DepthHistogram() const;     // [d] is the number of keys at depth d, the root has depth 0
+
+    // O(n) check of every red-black and bookkeeping invariant: colors, black heights, father
+    // links, subtree sizes, key order, the cached minimum and maximum (and RBT_THREADED links)
+    bool           IsValid() const;
 
 #ifndef NDEBUG
     void Dump() const;
 #endif
 
 private:
-    inline static Comp comparator_ = {};
     using Node = RBTNode<KeyT, Comp>;
 
-    Node* const nil_;
+    using NodeAlloc       = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+    using NodeAllocTraits = std::allocator_traits<NodeAlloc>;
+
+    // with an arena and trivial keys the destructor drops whole chunks instead of visiting every node
+    static constexpr bool RELEASES_IN_BULK = releases_in_bulk_v<NodeAlloc> && std::is_trivially_destructible_v<KeyT>;
+
+    // per tree, so a stateful comparator is never shared between trees or threads
+    [[no_unique_address]] Comp comparator_ = {};
+
+    NodeAlloc   alloc_;
+    Node* const nil_;       // shared by all trees of this type and never written, so nodes may move between trees
     Node* root_;
+    Node* leftmost_;        // minimum, nil_ in an empty tree
+    Node* rightmost_;       // maximum, nil_ in an empty tree
+
+#if RBT_STATS
+    mutable StatCounters stats_ = {};
+#endif
+
+    static Node* SharedNil_();
+
+    template <typename... Args>
+    Node* CreateNode_ (Args&&... args);
+    void  DestroyNode_(Node* node);
 
     Node *BeginNode_() const;
 
     Node* GetMin_(Node* subtree_root) const;
     Node* GetMax_(Node* subtree_root) const;
+    Node* Successor_  (Node* node) const;
+    Node* Predecessor_(Node* node) const;
+
+    // in-order neighbour links of RBT_THREADED, no-ops without it
+    void  Link_         (Node* prev, Node* next) const;
+    void  ThreadSubtree_(Node* sub_root) const;                 // links a whole detached subtree, O(size)
+    void  ThreadNodes_  (Node* sub_root, Node*& prev) const;
 
-    Node* FindInSubtree_(Node* sub_root, const KeyT& key) const;
+    // one loop behind every lookup: one comparison per level, only Comp, children prefetched a level ahead
+    struct Descent_
+    {
+        Node*       bound;      // first node not less then key, or greater then key for an upper descent; nil_ if none
+        Node*       last;       // last node visited, the father of key if it was inserted
+        bool        as_left;    // key would be the left son of last
+        std::size_t rank;       // keys of the subtree before bound, counted only when RANKED
+    };
+
+    template <bool UPPER, bool RANKED = false, typename K>
+    Descent_ Descend_(Node* sub_root, const K& key) const;
+
+    static constexpr std::size_t BATCH_GROUP    = 16;         // descents in flight at once in the batch lookups
+    static constexpr std::size_t BATCH_MIN_KEYS = 1 << 18;    // smaller trees mostly hit the cache, turns cost more than they hide
+
+    // Descend_ for count keys from root_, key_of(i) gives the i-th key, sink(i, descent) takes its result
+    template <bool UPPER, bool RANKED, typename KeyOf, typename Sink>
+    void DescendBatch_(std::size_t count, KeyOf key_of, Sink sink) const;
+
+    static void Prefetch_(const Node* node);
+
+    template <typename K>
+    Node* FindInSubtree_ (Node* sub_root, const K& key) const;
+    template <typename K>
+    Node* LowerBoundNode_(const K& key) const;
+    template <typename K>
+    Node* UpperBoundNode_(const K& key) const;
+    Node* FingerStart_  (Node* finger, const KeyT& key) const;
+    Node* SelectNode_   (std::size_t k) const;
+
+    template <typename K>
+    std::size_t CountLess_      (const K& key) const;
+    template <typename K>
+    std::size_t CountNotGreater_(const K& key) const;
+    template <typename K>
+    std::size_t CountInRange_   (const K& lo, const K& hi) const;
+    void        UpdateSizesUpward_(Node* from);
 
     void Transplant_   (Node* sub_root_1, Node* sub_root_2);
-    void LeftRotate_   (Node* sub_root);
-    void RightRotate_  (Node* sub_root);
+    void LeftRotate_   (Node* sub_root) { LeftRotate_ (sub_root, root_); }
+    void RightRotate_  (Node* sub_root) { RightRotate_(sub_root, root_); }
+
+    // the same for a detached subtree whose root is stored in root
+    void LeftRotate_   (Node* sub_root, Node*& root);
+    void RightRotate_  (Node* sub_root, Node*& root);
 
     void  RemoveSubtree_(Node* sub_root);
+    Node* BuildSubtree_ (KeyT* keys, std::size_t count, Node* father, unsigned depth, unsigned red_depth);
+
+    // every comparator call goes through Compare_, so RBT_STATS sees them all
+    template <typename L, typename R>
+    bool  Compare_         (const L& lhs, const R& rhs) const { RBT_STAT(comparisons); return comparator_(lhs, rhs); }
+    bool  Before_          (const KeyT& lhs, const KeyT& rhs) const { return Compare_(rhs, lhs); }
+    bool  IsStrictlySorted_(const std::vector<KeyT>& keys) const;
     Node* CopySubtree_  (Node* sub_root, Tree* dest_tree, Node* dest_father) const;
 
+    struct InsertPosition_
+    {
+        Node* node;         // the equal node if found, otherwise the father of the new one
+        bool  found;
+        bool  as_left;
+    };
+
+    template <typename K>
+    InsertPosition_ FindInsertPosition_(Node* sub_root, const K& key) const;
+
+    template <typename K>
+    std::pair<Node*, bool> InsertFrom_  (Node* sub_root, K&& new_key);
+    Node*                  InsertNode_  (Node* new_node);
+    Node*                  InsertHinted_(Node* hint, Node* new_node);
+    Node*                  AttachNode_  (Node* father, bool as_left, Node* new_node);
+
     void DeleteNode_   (Node* del_node);
 
     void FixupInsert_(Node* inserted);
-    void FixupDelete_(Node* fixup_node);
+    void FixupRedRed_(Node* inserted, Node*& root);     // FixupInsert_ without painting the root black
+    void FixupDelete_(Node* fixup_node, Node* fixup_father);
+
+    // subtree detached from any tree, its root may be red
+    struct Piece_
+    {
+        Node*    root;
+        unsigned black_height;      // black nodes on a path from root down, nil not counted
+    };
+
+    struct SplitPieces_
+    {
+        Piece_ less;
+        Node*  equal;               // detached node with the split key, nil_ if there is none
+        Piece_ greater;
+    };
+
+    static constexpr std::size_t PARALLEL_MIN_KEYS = 1 << 14;     // smaller set operations do not fork
+
+    unsigned     BlackHeight_(Node* sub_root) const;
+    int          ValidSubtree_(const Node* sub_root, const Node*& prev) const;     // black height, -1 if broken
+    Tree         Spawn_      () const;
+    Piece_       TakeAll_    ();
+    Piece_       AdoptNodes_ (Tree& other);
+    void         AdoptRoot_  (Node* root);
+    Piece_       Detach_     (Node* child, const Piece_& father);
+
+    Piece_       ExtractNodes_  (Node* first, Node* last);
+    Piece_       JoinNodes_     (Piece_ left, Node* key_node, Piece_ right);
+    Piece_       Join2Nodes_    (Piece_ left, Piece_ right);
+    Piece_       SplitLastNodes_(Piece_ sub_tree, Node*& last);
+    SplitPieces_ SplitNodes_    (Piece_ sub_tree, const KeyT& key);
+
+    Piece_ UnionNodes_       (Piece_ lhs, Piece_ rhs, std::vector<Node*>& garbage, unsigned fork_depth);
+    Piece_ IntersectionNodes_(Piece_ lhs, Piece_ rhs, std::vector<Node*>& garbage, unsigned fork_depth);
+    Piece_ DifferenceNodes_  (Piece_ lhs, Piece_ rhs, std::vector<Node*>& garbage, unsigned fork_depth);
+
+    template <typename LeftTask, typename RightTask>
+    void   RunBoth_    (std::size_t keys, unsigned fork_depth, std::vector<Node*>& garbage, LeftTask left_task, RightTask right_task);
+    void   FreeGarbage_(std::vector<Node*>& garbage);
 
     iterator       CreateIterator (Node* ptr)       { return iterator       (this, ptr); }
     const_iterator CreateIterator (Node* ptr) const { return const_iterator (this, ptr); }
@@ -97,61 +386,149 @@ private:
 };
 
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::Tree()
-    : nil_(new Node)
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Tree()
+    : Tree(Alloc())
+{}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Tree(const Alloc& alloc)
+    : alloc_(alloc)
+    , nil_(SharedNil_())
     , root_(nil_)
+    , leftmost_(nil_)
+    , rightmost_(nil_)
 {}
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::Tree(const Tree& other)
-    : nil_(new Node)
+template <typename KeyT, typename Comp, typename Alloc>
+template <std::input_iterator InputIt>
+Tree<KeyT, Comp, Alloc>::Tree(InputIt first, InputIt last, const Alloc& alloc)
+    : Tree(alloc)
+{
+    BulkLoad(first, last);
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Tree(const Tree& other)
+    : comparator_(other.comparator_)
+    , alloc_(NodeAllocTraits::select_on_container_copy_construction(other.alloc_))
+    , nil_(SharedNil_())
     , root_(nil_)
+    , leftmost_(nil_)
+    , rightmost_(nil_)
 {
-    root_ = other.CopySubtree_(other.root_, this, nil_);
+    root_      = other.CopySubtree_(other.root_, this, nil_);
+    leftmost_  = (root_ == nil_) ? nil_ : GetMin_(root_);
+    rightmost_ = (root_ == nil_) ? nil_ : GetMax_(root_);
+
+    ThreadSubtree_(root_);
 }
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>& Tree<KeyT, Comp>::operator=(const Tree& other)
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>& Tree<KeyT, Comp, Alloc>::operator=(const Tree& other)
 {
+    if (this == &other)
+        return *this;
+
     RemoveSubtree_(root_);
 
-    root_ = other.CopySubtree_(other.root_, this, nil_);
+    comparator_ = other.comparator_;
+    root_       = other.CopySubtree_(other.root_, this, nil_);
+    leftmost_   = (root_ == nil_) ? nil_ : GetMin_(root_);
+    rightmost_  = (root_ == nil_) ? nil_ : GetMax_(root_);
+
+    ThreadSubtree_(root_);
 
     return *this;
 }
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::Tree(Tree&& other)
+// the allocator is copied, not moved, so the emptied other stays usable
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Tree(Tree&& other)
+    : comparator_(other.comparator_)
+    , alloc_(other.alloc_)
+    , nil_(SharedNil_())
+    , root_     (std::exchange(other.root_,      other.nil_))
+    , leftmost_ (std::exchange(other.leftmost_,  other.nil_))
+    , rightmost_(std::exchange(other.rightmost_, other.nil_))
+{}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>& Tree<KeyT, Comp, Alloc>::operator=(Tree&& other)
 {
-    root_ = other.root_;
-    nil_  = other.nil_;
+    if (this == &other)
+        return *this;
+
+    clear();
+
+    comparator_ = other.comparator_;
+
+    if constexpr (NodeAllocTraits::propagate_on_container_move_assignment::value)
+        alloc_ = other.alloc_;
+
+    AdoptRoot_(AdoptNodes_(other).root);
+
+    return *this;
 }
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>& Tree<KeyT, Comp>::operator=(Tree&& other)
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::~Tree()
 {
-    RemoveSubtree_(root_);
+    // an arena still used by another tree (after Split, ExtractRange, ...) must get the slots back
+    if constexpr (RELEASES_IN_BULK)
+    {
+        if (alloc_.IsShared())
+            RemoveSubtree_(root_);
+    }
+
+    else
+    {
+        RemoveSubtree_(root_);
+    }
+}
 
-    root_ = other.root_;
-    nil_  = other.nil_;
 
-    return *this;
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::SharedNil_()
+{
+    static Node nil;
+
+    return &nil;
 }
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::~Tree()
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::clear()
 {
     RemoveSubtree_(root_);
-    
-    delete nil_;
+
+    root_      = nil_;
+    leftmost_  = nil_;
+    rightmost_ = nil_;
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::Transplant_(Node* replaceable, Node* substitute)
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename... Args>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::CreateNode_(Args&&... args)
+{
+    Node* node = NodeAllocTraits::allocate(alloc_, 1);
+    NodeAllocTraits::construct(alloc_, node, std::forward<Args>(args)...);
+
+    return node;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::DestroyNode_(Node* node)
+{
+    NodeAllocTraits::destroy   (alloc_, node);
+    NodeAllocTraits::deallocate(alloc_, node, 1);
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::Transplant_(Node* replaceable, Node* substitute)
 {
-    RLSU_ASSERT(replaceable);
+    RBT_ASSERT(replaceable);
 
     if (replaceable == root_)
         root_ = substitute;
@@ -162,15 +539,18 @@ void Tree<KeyT, Comp>::Transplant_(Node* replaceable, Node* substitute)
     else
         replaceable->father->right = substitute;
 
-    substitute->father = replaceable->father;
+    if (substitute != nil_)
+        substitute->father = replaceable->father;
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::LeftRotate_(Node* sub_root)
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::LeftRotate_(Node* sub_root, Node*& root)
 {
-    RLSU_ASSERT(sub_root);
-    RLSU_ASSERT(sub_root->right != nil_);
+    RBT_ASSERT(sub_root);
+    RBT_ASSERT(sub_root->right != nil_);
+
+    RBT_STAT(left_rotations);
 
     Node* right_son = sub_root->right;
     sub_root->right = right_son->left;
@@ -180,8 +560,8 @@ void Tree<KeyT, Comp>::LeftRotate_(Node* sub_root)
 
     right_son->father = sub_root->father;
 
-    if (sub_root == root_)
-        root_ = right_son;
+    if (sub_root->father == nil_)
+        root = right_son;
 
     else if (sub_root == sub_root->father->left)
         sub_root->father->left = right_son;
@@ -192,14 +572,19 @@ void Tree<KeyT, Comp>::LeftRotate_(Node* sub_root)
     right_son->left = sub_root;
 
     sub_root->father = right_son;
+
+    right_son->size = sub_root->size;
+    sub_root ->size = sub_root->left->size + sub_root->right->size + 1;
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::RightRotate_(Node* sub_root)
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::RightRotate_(Node* sub_root, Node*& root)
 {
-    RLSU_ASSERT(sub_root);
-    RLSU_ASSERT(sub_root->left != nil_);
+    RBT_ASSERT(sub_root);
+    RBT_ASSERT(sub_root->left != nil_);
+
+    RBT_STAT(right_rotations);
 
     Node* left_son = sub_root->left;
     sub_root->left = left_son->right;
@@ -209,8 +594,8 @@ void Tree<KeyT, Comp>::RightRotate_(Node* sub_root)
 
     left_son->father = sub_root->father;
 
-    if (sub_root == root_)
-        root_ = left_son;
+    if (sub_root->father == nil_)
+        root = left_son;
 
     else if (sub_root == sub_root->father->right)
         sub_root->father->right = left_son;
@@ -221,38 +606,42 @@ void Tree<KeyT, Comp>::RightRotate_(Node* sub_root)
     left_son->right = sub_root;
 
     sub_root->father = left_son;
+
+    left_son->size = sub_root->size;
+    sub_root->size = sub_root->left->size + sub_root->right->size + 1;
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::RemoveSubtree_(Node* sub_root)
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::RemoveSubtree_(Node* sub_root)
 {
     if (sub_root == nil_)
         return;
 
     if (sub_root->left != nil_)
-        ERROR_HANDLE(RemoveSubtree_(sub_root->left));
+        RBT_HANDLE(RemoveSubtree_(sub_root->left));
 
     if (sub_root->right != nil_)
-        ERROR_HANDLE(RemoveSubtree_(sub_root->right));
+        RBT_HANDLE(RemoveSubtree_(sub_root->right));
 
-    delete sub_root;
+    DestroyNode_(sub_root);
 }
 
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::Node* Tree<KeyT, Comp>::CopySubtree_(Node* sub_root, Tree* dest_tree, Node* dest_father) const
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::CopySubtree_(Node* sub_root, Tree* dest_tree, Node* dest_father) const
 {
-    RLSU_ASSERT(sub_root);
-    RLSU_ASSERT(dest_tree);
-    RLSU_ASSERT(dest_father);
+    RBT_ASSERT(sub_root);
+    RBT_ASSERT(dest_tree);
+    RBT_ASSERT(dest_father);
  
-    RLSU_INFO("key = {}, nil = {}, sr = {}, l = {}, r = {}", sub_root->key, (void*)nil_, (void*) sub_root, (void*) sub_root->left, (void*) sub_root->right);
+    RBT_INFO("key = {}, nil = {}, sr = {}, l = {}, r = {}", sub_root->key, (void*)nil_, (void*) sub_root, (void*) sub_root->left, (void*) sub_root->right);
 
     if (sub_root == nil_)
         return dest_tree->nil_;
 
-    Node* sub_root_cpy = new Node(sub_root->key, sub_root->color, dest_tree->nil_, dest_tree->nil_, dest_father);
+    Node* sub_root_cpy = dest_tree->CreateNode_(sub_root->key, sub_root->color, dest_tree->nil_, dest_tree->nil_, dest_father);
+    sub_root_cpy->size = sub_root->size;
 
     sub_root_cpy->left  = CopySubtree_(sub_root->left, dest_tree, sub_root_cpy);
     sub_root_cpy->right = CopySubtree_(sub_root->right, dest_tree, sub_root_cpy);
@@ -261,51 +650,301 @@ Tree<KeyT, Comp>::Node* Tree<KeyT, Comp>::CopySubtree_(Node* sub_root, Tree* des
 }
 
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::iterator Tree<KeyT, Comp>::insert(const KeyT& new_key)
+template <typename KeyT, typename Comp, typename Alloc>
+template <std::input_iterator InputIt>
+void Tree<KeyT, Comp, Alloc>::BulkLoad(InputIt first, InputIt last)
 {
-    Node* future_father = nil_;
-    Node* iterator_node = root_;
+    auto before = [this](const KeyT& lhs, const KeyT& rhs) { return Before_(lhs, rhs); };
+
+    std::vector<KeyT> keys(first, last);
+
+    if (!IsStrictlySorted_(keys))
+    {
+        Parallel::Sort(keys.begin(), keys.end(), before);
+        keys.erase(std::unique(keys.begin(), keys.end(), [&](const KeyT& lhs, const KeyT& rhs) { return !before(lhs, rhs); }),
+                   keys.end());
+    }
 
-    while (iterator_node != nil_)
+    if (root_ != nil_)
     {
-        future_father = iterator_node;
+        std::vector<KeyT> merged;
+        merged.reserve(size() + keys.size());
 
-        if (comparator_(iterator_node->key, new_key))
-            iterator_node = iterator_node->left;
+        // keys already in the tree win over equal loaded ones
+        std::set_union(begin(), end(), keys.begin(), keys.end(), std::back_inserter(merged), before);
 
-        else if (comparator_(new_key, iterator_node->key))
-            iterator_node = iterator_node->right;
+        keys.swap(merged);
 
-        else
-            return CreateIterator(iterator_node);
+        RemoveSubtree_(root_);
+        root_      = nil_;
+        leftmost_  = nil_;
+        rightmost_ = nil_;
+    }
+
+    if (keys.empty())
+        return;
+
+    // all levels above the deepest one are full, painting the deepest one red keeps black heights equal
+    unsigned red_depth = static_cast<unsigned>(std::bit_width(keys.size()) - 1);
+
+    root_ = BuildSubtree_(keys.data(), keys.size(), nil_, 0, red_depth);
+    root_->color = NodeColor::BLACK;
+
+    leftmost_  = GetMin_(root_);
+    rightmost_ = GetMax_(root_);
+
+    ThreadSubtree_(root_);
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::BuildSubtree_(KeyT* keys, std::size_t count, Node* father,
+                                                                     unsigned depth, unsigned red_depth)
+{
+    if (count == 0)
+        return nil_;
+
+    std::size_t middle = count / 2;
+
+    NodeColor color = (depth == red_depth) ? NodeColor::RED : NodeColor::BLACK;
+
+    Node* sub_root = CreateNode_(std::in_place, std::move(keys[middle]));
+
+    sub_root->color  = color;
+    sub_root->father = father;
+    sub_root->size   = count;
+
+    sub_root->left   = BuildSubtree_(keys,              middle,             sub_root, depth + 1, red_depth);
+    sub_root->right  = BuildSubtree_(keys + middle + 1, count - middle - 1, sub_root, depth + 1, red_depth);
+
+    return sub_root;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+bool Tree<KeyT, Comp, Alloc>::IsStrictlySorted_(const std::vector<KeyT>& keys) const
+{
+    for (std::size_t i = 1; i < keys.size(); ++i)
+    {
+        if (!Before_(keys[i - 1], keys[i]))
+            return false;
+    }
+
+    return true;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+Tree<KeyT, Comp, Alloc>::InsertPosition_ Tree<KeyT, Comp, Alloc>::FindInsertPosition_(Node* sub_root, const K& key) const
+{
+    Descent_ descent = Descend_<false>(sub_root, key);
+
+    // bound is not less then key, so it is equal unless it is greater
+    if (descent.bound != nil_ && !Compare_(descent.bound->key, key))
+        return {descent.bound, true, false};
+
+    return {descent.last, false, descent.as_left};
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+std::pair<typename Tree<KeyT, Comp, Alloc>::Node*, bool> Tree<KeyT, Comp, Alloc>::InsertFrom_(Node* sub_root, K&& new_key)
+{
+    InsertPosition_ position = FindInsertPosition_(sub_root, new_key);
+
+    if (position.found)
+        return {position.node, false};
+
+    Node* new_node = CreateNode_(std::in_place, std::forward<K>(new_key));
+
+    return {AttachNode_(position.node, position.as_left, new_node), true};
+}
+
+
+// links an already built node by a full descent, drops it if its key is present
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::InsertNode_(Node* new_node)
+{
+    InsertPosition_ position = FindInsertPosition_(root_, new_node->key);
+
+    if (position.found)
+    {
+        DestroyNode_(new_node);
+        return position.node;
     }
 
-    Node* new_node = new Node(new_key, NodeColor::RED, nil_, nil_, nil_);
-    new_node->father = future_father;
+    return AttachNode_(position.node, position.as_left, new_node);
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::AttachNode_(Node* father, bool as_left, Node* new_node)
+{
+    new_node->color  = NodeColor::RED;
+    new_node->size   = 1;
+    new_node->left   = nil_;
+    new_node->right  = nil_;
+    new_node->father = father;
 
-    if (future_father == nil_)
+    if (father == nil_)
         root_ = new_node;
 
-    else if (comparator_(new_key, future_father->key))
-        future_father->right = new_node;
+    else if (as_left)
+        father->left = new_node;
 
     else
-        future_father->left = new_node;
+        father->right = new_node;
 
-    ERROR_HANDLE(FixupInsert_(new_node));
+    if (father == nil_)
+        leftmost_ = rightmost_ = new_node;
 
-    return CreateIterator(new_node);
+    else if (father == leftmost_ && as_left)
+        leftmost_ = new_node;
+
+    else if (father == rightmost_ && !as_left)
+        rightmost_ = new_node;
+
+#if RBT_THREADED
+    // a new left child comes right before its father, a new right child right after it
+    Node* prev = (father == nil_) ? nil_ : (as_left ? father->prev : father);
+    Node* next = (father == nil_) ? nil_ : (as_left ? father : father->next);
+
+    Link_(prev, new_node);
+    Link_(new_node, next);
+#endif
+
+    UpdateSizesUpward_(father);
+
+    RBT_HANDLE(FixupInsert_(new_node));
+
+    return new_node;
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::FixupInsert_(Node* inserted)
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::InsertHinted_(Node* hint, Node* new_node)
+{
+    const KeyT& new_key = new_node->key;
+
+    Node* prev = (hint == nil_) ? rightmost_ : Predecessor_(hint);
+
+    // the hint is right when prev < new_key < hint
+    if ((hint != nil_ && !Before_(new_key, hint->key)) || (prev != nil_ && !Before_(prev->key, new_key)))
+        return InsertNode_(new_node);
+
+    // new_key goes to the free left link of hint or to the free right link of prev
+    if (hint != nil_ && hint->left == nil_)
+        return AttachNode_(hint, true, new_node);
+
+    return AttachNode_(prev, false, new_node);
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename... Args>
+Tree<KeyT, Comp, Alloc>::iterator Tree<KeyT, Comp, Alloc>::emplace(Args&&... args)
+{
+    Node* new_node = CreateNode_(std::in_place, std::forward<Args>(args)...);
+
+    return CreateIterator(InsertNode_(new_node));
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename... Args>
+Tree<KeyT, Comp, Alloc>::iterator Tree<KeyT, Comp, Alloc>::emplace_hint(const_iterator hint, Args&&... args)
+{
+    Node* new_node = CreateNode_(std::in_place, std::forward<Args>(args)...);
+
+    return CreateIterator(InsertHinted_(hint.node_ptr_, new_node));
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+std::pair<typename Tree<KeyT, Comp, Alloc>::iterator, bool> Tree<KeyT, Comp, Alloc>::try_emplace(K&& key)
+{
+    InsertPosition_ position = FindInsertPosition_(root_, key);
+
+    if (position.found)
+        return {CreateIterator(position.node), false};
+
+    // the position was found for key, so the node is built from key and nothing else
+    Node* new_node = CreateNode_(std::in_place, std::forward<K>(key));
+
+    return {CreateIterator(AttachNode_(position.node, position.as_left, new_node)), true};
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+std::size_t Tree<KeyT, Comp, Alloc>::InsertBatch(std::span<const KeyT> batch)
+{
+    std::vector<KeyT> keys(batch.begin(), batch.end());
+
+    if (!IsStrictlySorted_(keys))
+        std::sort(keys.begin(), keys.end(), [this](const KeyT& lhs, const KeyT& rhs) { return Before_(lhs, rhs); });
+
+    std::size_t inserted = 0;
+    Node*       finger   = nil_;
+
+    for (KeyT& key : keys)
+    {
+        auto [node, is_new] = InsertFrom_(FingerStart_(finger, key), std::move(key));
+
+        inserted += is_new;
+        finger    = node;
+    }
+
+    return inserted;
+}
+
+
+// Lowest ancestor of finger whose subtree spans key, for key not less than finger->key:
+// climbing stops at the first left-child edge whose father is greater than key.
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::FingerStart_(Node* finger, const KeyT& key) const
+{
+    if (finger == nil_)
+        return root_;
+
+    Node* cur_node = finger;
+
+    while (cur_node != root_)
+    {
+        Node* father = cur_node->father;
+
+        if (cur_node == father->left && Compare_(father->key, key))
+            break;
+
+        cur_node = father;
+    }
+
+    return cur_node;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::FixupInsert_(Node* inserted)
+{
+    FixupRedRed_(inserted, root_);
+
+    root_->color = NodeColor::BLACK;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::FixupRedRed_(Node* inserted, Node*& root)
 {
     Node *cur_node = inserted;
 
+    RBT_STAT(insert_fixups);
+
     while (cur_node->father->color == NodeColor::RED)
     {
+        RBT_STAT(insert_fixup_iterations);
+
         Node* father  = cur_node->father;
         Node* grandpa = father->father;
 
@@ -325,7 +964,7 @@ void Tree<KeyT, Comp>::FixupInsert_(Node* inserted)
             else if (cur_node == father->right)
             {
                 cur_node = father;
-                ERROR_HANDLE(LeftRotate_(cur_node));
+                RBT_HANDLE(LeftRotate_(cur_node, root));
             }
 
             else
@@ -333,7 +972,7 @@ void Tree<KeyT, Comp>::FixupInsert_(Node* inserted)
                 father->color  = NodeColor::BLACK;
                 grandpa->color = NodeColor::RED;
 
-                ERROR_HANDLE(RightRotate_(grandpa));
+                RBT_HANDLE(RightRotate_(grandpa, root));
             }
         }
 
@@ -353,7 +992,7 @@ void Tree<KeyT, Comp>::FixupInsert_(Node* inserted)
             else if (cur_node == father->left)
             {
                 cur_node = father;
-                ERROR_HANDLE(RightRotate_(cur_node));
+                RBT_HANDLE(RightRotate_(cur_node, root));
             }
 
             else
@@ -361,35 +1000,46 @@ void Tree<KeyT, Comp>::FixupInsert_(Node* inserted)
                 father->color  = NodeColor::BLACK;
                 grandpa->color = NodeColor::RED;
 
-                ERROR_HANDLE(LeftRotate_(grandpa));
+                RBT_HANDLE(LeftRotate_(grandpa, root));
             }
         }
     }
-
-    root_->color = NodeColor::BLACK;
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::DeleteNode_(Node* del_node)
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::DeleteNode_(Node* del_node)
 {
     Node* y_node = del_node;
     NodeColor y_start_color = y_node->color;
     
-    Node* fixup_node = nil_;
+    Node* fixup_node   = nil_;
+    Node* fixup_father = nil_;     // tracked here, the shared nil_ may not store it
 
     if (del_node == nil_)
         return;
 
+    if (del_node == leftmost_)
+        leftmost_ = Successor_(del_node);
+
+    if (del_node == rightmost_)
+        rightmost_ = Predecessor_(del_node);
+
+#if RBT_THREADED
+    Link_(del_node->prev, del_node->next);
+#endif
+
     if (del_node->left == nil_)
     {
-        fixup_node = del_node->right;
+        fixup_node   = del_node->right;
+        fixup_father = del_node->father;
         Transplant_(del_node, del_node->right);
     }
 
     else if (del_node->right == nil_)
     {
-        fixup_node = del_node->left;
+        fixup_node   = del_node->left;
+        fixup_father = del_node->father;
         Transplant_(del_node, del_node->left);
     }
     
@@ -401,11 +1051,12 @@ void Tree<KeyT, Comp>::DeleteNode_(Node* del_node)
 
         if (y_node->father == del_node)
         {
-            fixup_node->father = y_node;
+            fixup_father = y_node;
         }
 
         else
         {
+            fixup_father = y_node->father;
             Transplant_(y_node, y_node->right);
             y_node->right = del_node->right;
             y_node->right->father = y_node;
@@ -417,19 +1068,26 @@ void Tree<KeyT, Comp>::DeleteNode_(Node* del_node)
         y_node->color = del_node->color;
     }
 
-    delete del_node;
+    // fixup_father is the lowest node whose subtree lost a key
+    UpdateSizesUpward_(fixup_father);
+
+    DestroyNode_(del_node);
 
     if (y_start_color == NodeColor::BLACK)
-        ERROR_HANDLE(FixupDelete_(fixup_node));
+        RBT_HANDLE(FixupDelete_(fixup_node, fixup_father));
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::FixupDelete_(Node* fixup_node, Node* fixup_father)
 {
+    RBT_STAT(delete_fixups);
+
     while (fixup_node != root_ && fixup_node->color == NodeColor::BLACK)
     {
-        Node* father = fixup_node->father;
+        RBT_STAT(delete_fixup_iterations);
+
+        Node* father = fixup_father;
 
         if (fixup_node == father->left)
         {
@@ -440,7 +1098,7 @@ void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
                 brother->color = NodeColor::BLACK;
                 father ->color = NodeColor::RED;
 
-                ERROR_HANDLE(LeftRotate_(father));
+                RBT_HANDLE(LeftRotate_(father));
 
                 brother = father->right;
             }
@@ -449,7 +1107,8 @@ void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
             if (brother->left->color == NodeColor::BLACK && brother->right->color == NodeColor::BLACK)
             {
                 brother->color = NodeColor::RED;
-                fixup_node = father;
+                fixup_node   = father;
+                fixup_father = father->father;
             }
 
             else if (brother->right->color == NodeColor::BLACK)
@@ -457,7 +1116,7 @@ void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
                 brother->left->color = NodeColor::BLACK;
                 brother->color       = NodeColor::RED;
 
-                ERROR_HANDLE(RightRotate_(brother));
+                RBT_HANDLE(RightRotate_(brother));
 
                 brother = father->right;
             }
@@ -468,7 +1127,7 @@ void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
                 father        ->color = NodeColor::BLACK;
                 brother->right->color = NodeColor::BLACK;
 
-                ERROR_HANDLE(LeftRotate_(father));
+                RBT_HANDLE(LeftRotate_(father));
 
                 fixup_node  = root_;
             }
@@ -483,7 +1142,7 @@ void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
                 brother->color = NodeColor::BLACK;
                 father ->color = NodeColor::RED;
 
-                ERROR_HANDLE(RightRotate_(father));
+                RBT_HANDLE(RightRotate_(father));
 
                 brother = father->left;
             }
@@ -492,7 +1151,8 @@ void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
             if (brother->right->color == NodeColor::BLACK && brother->left->color == NodeColor::BLACK)
             {
                 brother->color = NodeColor::RED;
-                fixup_node = father;
+                fixup_node   = father;
+                fixup_father = father->father;
             }
 
             else if (brother->left->color == NodeColor::BLACK)
@@ -500,7 +1160,7 @@ void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
                 brother->right->color = NodeColor::BLACK;
                 brother->color        = NodeColor::RED;
 
-                ERROR_HANDLE(LeftRotate_(brother));
+                RBT_HANDLE(LeftRotate_(brother));
 
                 brother = father->left;
             }
@@ -511,109 +1171,312 @@ void Tree<KeyT, Comp>::FixupDelete_(Node* fixup_node)
                 father       ->color = NodeColor::BLACK;
                 brother->left->color = NodeColor::BLACK;
 
-                ERROR_HANDLE(RightRotate_(father));
+                RBT_HANDLE(RightRotate_(father));
 
                 fixup_node  = root_;
             }            
         }
     }
 
-    fixup_node->color = NodeColor::BLACK;
+    if (fixup_node != nil_)
+        fixup_node->color = NodeColor::BLACK;
 }
 
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::Node* Tree<KeyT, Comp>::BeginNode_() const
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::BeginNode_() const
 {
-    if (root_ == nil_)
-        return nil_;
-
-    return GetMin_(root_);
+    return leftmost_;
 }
 
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::Node* Tree<KeyT, Comp>::FindInSubtree_(Node* sub_root, const KeyT& key) const
+// The left/right choice depends on the key just loaded, so the loop waits for one node
+// per level anyway; both sons are requested while the comparison runs, and the one
+// taken is already on its way when the next iteration reads it.
+template <typename KeyT, typename Comp, typename Alloc>
+template <bool UPPER, bool RANKED, typename K>
+Tree<KeyT, Comp, Alloc>::Descent_ Tree<KeyT, Comp, Alloc>::Descend_(Node* sub_root, const K& key) const
 {
-    if (sub_root == nil_)
-        return nil_;
+    Descent_ descent = {nil_, (sub_root == nil_) ? nil_ : sub_root->father, false, 0};
 
-    if (key == sub_root->key)
-        return sub_root;
+    Node* cur_node = sub_root;
 
-    if (comparator_(key, sub_root->key))
-        return FindInSubtree_(sub_root->right, key);
-    
-    else
-        return FindInSubtree_(sub_root->left, key);
-}
+    RBT_STAT(descents);
 
+    while (cur_node != nil_)
+    {
+        RBT_INFO("Descend: cur_node->key = {}", cur_node->key);
+        RBT_STAT(descent_nodes);
 
+        Prefetch_(cur_node->left);
+        Prefetch_(cur_node->right);
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::iterator Tree<KeyT, Comp>::LowerBound(const KeyT& key)
-{
-    Node* result = nil_;
-    Node* cur_node   = root_;
+        // lower: cur_node >= key <=> !(key > cur_node), upper: cur_node > key
+        bool goes_left = UPPER ? Compare_(cur_node->key, key) : !Compare_(key, cur_node->key);
 
-    while (cur_node != nil_)
-    {
-        RLSU_INFO("LowerBound: cur_node->key = {}", cur_node->key);
+        descent.last    = cur_node;
+        descent.as_left = goes_left;
 
-        if (!comparator_(key, cur_node->key))  //  if (result->key >= key) <=> if (!(key > result->key))
+        if (goes_left)
         {
-            result   = cur_node;
-            cur_node = cur_node->left;
+            descent.bound = cur_node;
+            cur_node      = cur_node->left;
         }
 
         else
         {
+            if constexpr (RANKED)
+                descent.rank += cur_node->left->size + 1;
+
             cur_node = cur_node->right;
         }
     }
 
-    return CreateIterator(result);
+    return descent;
 }
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::iterator Tree<KeyT, Comp>::UpperBound(const KeyT& key)
+// Every descent prefetches both sons of its node, steps and gives way to the others; when its
+// turn comes again the son it took is usually in cache. Ranks add the size of the left son
+// passed by one turn late, it was prefetched together with the one taken.
+template <typename KeyT, typename Comp, typename Alloc>
+template <bool UPPER, bool RANKED, typename KeyOf, typename Sink>
+void Tree<KeyT, Comp, Alloc>::DescendBatch_(std::size_t count, KeyOf key_of, Sink sink) const
 {
-    Node* result = nil_;
-    Node* cur_node   = root_;
+    if (size() < BATCH_MIN_KEYS)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            sink(i, Descend_<UPPER, RANKED>(root_, key_of(i)));
 
-    while (cur_node != nil_)
+        return;
+    }
+
+    for (std::size_t first = 0; first < count; first += BATCH_GROUP)
     {
-        if (comparator_(cur_node->key, key))  // if (result->key > key)
+        std::size_t group = std::min(BATCH_GROUP, count - first);
+
+        Node*       cur_nodes   [BATCH_GROUP];
+        Node*       left_behind [BATCH_GROUP];      // nil_ or the left son whose size is still to be added
+        Descent_    descents    [BATCH_GROUP];
+        std::size_t active      [BATCH_GROUP];
+        std::size_t active_count = group;
+
+        for (std::size_t lane = 0; lane < group; ++lane)
         {
-            result = cur_node;
-            cur_node   = cur_node->left;
+            cur_nodes  [lane] = root_;
+            left_behind[lane] = nil_;
+            descents   [lane] = {nil_, nil_, false, 0};
+            active     [lane] = lane;
         }
 
-        else
+        while (active_count != 0)
         {
-            cur_node = cur_node->right;
+            for (std::size_t slot = 0; slot < active_count; )
+            {
+                std::size_t lane     = active[slot];
+                Node*       cur_node = cur_nodes[lane];
+                Descent_&   descent  = descents[lane];
+
+                if constexpr (RANKED)
+                {
+                    if (left_behind[lane] != nil_)
+                    {
+                        descent.rank     += left_behind[lane]->size;
+                        left_behind[lane] = nil_;
+                    }
+                }
+
+                if (cur_node == nil_)
+                {
+                    RBT_STAT(descents);
+                    sink(first + lane, descent);
+
+                    active[slot] = active[--active_count];
+                    continue;
+                }
+
+                RBT_STAT(descent_nodes);
+
+                Prefetch_(cur_node->left);
+                Prefetch_(cur_node->right);
+
+                const KeyT& key = key_of(first + lane);
+
+                bool goes_left = UPPER ? Compare_(cur_node->key, key) : !Compare_(key, cur_node->key);
+
+                if (goes_left)
+                {
+                    descent.bound   = cur_node;
+                    cur_nodes[lane] = cur_node->left;
+                }
+
+                else
+                {
+                    if constexpr (RANKED)
+                    {
+                        descent.rank     += 1;
+                        left_behind[lane] = cur_node->left;
+                    }
+
+                    cur_nodes[lane] = cur_node->right;
+                }
+
+                ++slot;
+            }
         }
     }
+}
 
-    return CreateIterator(result);
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::Prefetch_([[maybe_unused]] const Node* node)
+{
+#if RBT_PREFETCH && defined(__GNUC__)
+    __builtin_prefetch(node);
+#endif
 }
 
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::Node* Tree<KeyT, Comp>::GetMin_(Node* subtree_root) const
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::FindBatch(std::span<const KeyT> keys, std::span<const_iterator> results) const
 {
-    Node* cur_node = subtree_root;
+    RBT_ASSERT(keys.size() == results.size());
 
-    while (cur_node->left != nil_)
+    DescendBatch_<false, false>(keys.size(), [&](std::size_t i) -> const KeyT& { return keys[i]; },
+                                [&](std::size_t i, const Descent_& descent)
     {
-        cur_node = cur_node->left;
+        Node* bound = descent.bound;
+
+        results[i] = CreateIterator((bound != nil_ && !Compare_(bound->key, keys[i])) ? bound : nil_);
+    });
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::LowerBoundBatch(std::span<const KeyT> keys, std::span<const_iterator> results) const
+{
+    RBT_ASSERT(keys.size() == results.size());
+
+    DescendBatch_<false, false>(keys.size(), [&](std::size_t i) -> const KeyT& { return keys[i]; },
+                                [&](std::size_t i, const Descent_& descent) { results[i] = CreateIterator(descent.bound); });
+}
+
+// the same two counts as CountInRange_, each in its own batched pass
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::CountInRangeBatch(std::span<const std::pair<KeyT, KeyT>> ranges, std::span<std::size_t> counts) const
+{
+    RBT_ASSERT(ranges.size() == counts.size());
+
+    DescendBatch_<false, true>(ranges.size(), [&](std::size_t i) -> const KeyT& { return ranges[i].first; },
+                               [&](std::size_t i, const Descent_& descent) { counts[i] = descent.rank; });
+
+    DescendBatch_<true, true>(ranges.size(), [&](std::size_t i) -> const KeyT& { return ranges[i].second; },
+                              [&](std::size_t i, const Descent_& descent)
+    {
+        const auto& [lo, hi] = ranges[i];
+
+        counts[i] = Compare_(lo, hi) ? 0 : descent.rank - counts[i];
+    });
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::FindInSubtree_(Node* sub_root, const K& key) const
+{
+    Node* bound = Descend_<false>(sub_root, key).bound;
+
+    return (bound != nil_ && !Compare_(bound->key, key)) ? bound : nil_;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::LowerBoundNode_(const K& key) const
+{
+    return Descend_<false>(root_, key).bound;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::UpperBoundNode_(const K& key) const
+{
+    return Descend_<true>(root_, key).bound;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+std::size_t Tree<KeyT, Comp, Alloc>::CountLess_(const K& key) const
+{
+    return Descend_<false, true>(root_, key).rank;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+std::size_t Tree<KeyT, Comp, Alloc>::CountNotGreater_(const K& key) const
+{
+    return Descend_<true, true>(root_, key).rank;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename K>
+std::size_t Tree<KeyT, Comp, Alloc>::CountInRange_(const K& lo, const K& hi) const
+{
+    if (Compare_(lo, hi))
+        return 0;
+
+    return CountNotGreater_(hi) - CountLess_(lo);
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::SelectNode_(std::size_t k) const
+{
+    Node* cur_node = root_;
+
+    while (cur_node != nil_)
+    {
+        std::size_t left_size = cur_node->left->size;
+
+        if (k < left_size)
+            cur_node = cur_node->left;
+
+        else if (k == left_size)
+            return cur_node;
+
+        else
+        {
+            k -= left_size + 1;
+            cur_node = cur_node->right;
+        }
+    }
+
+    return nil_;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::UpdateSizesUpward_(Node* from)
+{
+    for (Node* cur_node = from; cur_node != nil_; cur_node = cur_node->father)
+    {
+        cur_node->size = cur_node->left->size + cur_node->right->size + 1;
+    }
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::GetMin_(Node* subtree_root) const
+{
+    Node* cur_node = subtree_root;
+
+    while (cur_node->left != nil_)
+    {
+        cur_node = cur_node->left;
     }
 
     return cur_node;
 }
 
-template <typename KeyT, typename Comp>
-Tree<KeyT, Comp>::Node* Tree<KeyT, Comp>::GetMax_(Node* subtree_root) const
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::GetMax_(Node* subtree_root) const
 {
     Node* cur_node = subtree_root;
 
@@ -625,11 +1488,864 @@ Tree<KeyT, Comp>::Node* Tree<KeyT, Comp>::GetMax_(Node* subtree_root) const
     return cur_node;
 }
 
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::Successor_(Node* node) const
+{
+#if RBT_THREADED
+    return node->next;
+#else
+    if (node->right != nil_)
+        return GetMin_(node->right);
+
+    Node* father = node->father;
+
+    while (father != nil_ && node == father->right)
+    {
+        RBT_STAT(climbs);
+
+        node   = father;
+        father = node->father;
+    }
+
+    return father;
+#endif
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Node* Tree<KeyT, Comp, Alloc>::Predecessor_(Node* node) const
+{
+#if RBT_THREADED
+    return node->prev;
+#else
+    if (node->left != nil_)
+        return GetMax_(node->left);
+
+    Node* father = node->father;
+
+    while (father != nil_ && node == father->left)
+    {
+        RBT_STAT(climbs);
+
+        node   = father;
+        father = node->father;
+    }
+
+    return father;
+#endif
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::Link_([[maybe_unused]] Node* prev, [[maybe_unused]] Node* next) const
+{
+#if RBT_THREADED
+    if (prev != nil_)
+        prev->next = next;
+
+    if (next != nil_)
+        next->prev = prev;
+#endif
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::ThreadSubtree_([[maybe_unused]] Node* sub_root) const
+{
+#if RBT_THREADED
+    Node* prev = nil_;
+
+    ThreadNodes_(sub_root, prev);
+    Link_(prev, nil_);
+#endif
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::ThreadNodes_(Node* sub_root, Node*& prev) const
+{
+    if (sub_root == nil_)
+        return;
+
+    ThreadNodes_(sub_root->left, prev);
+
+    Link_(prev, sub_root);
+    prev = sub_root;
+
+    ThreadNodes_(sub_root->right, prev);
+}
+
+
+// nodes not less than lo wait on the stack for their turn, smaller ones are skipped with their left subtrees
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename Fn>
+void Tree<KeyT, Comp, Alloc>::ForEachInRange(const KeyT& lo, const KeyT& hi, Fn&& fn) const
+{
+    static constexpr std::size_t MAX_HEIGHT = 2 * 64;      // red-black height is below 2 * log2(size + 1)
+
+    if (Compare_(lo, hi))
+        return;
+
+    const Node* stack[MAX_HEIGHT];
+    std::size_t stack_size = 0;
+
+    const Node* cur_node = root_;
+
+    while (true)
+    {
+        while (cur_node != nil_)
+        {
+            if (Before_(cur_node->key, lo))
+            {
+                cur_node = cur_node->right;
+            }
+
+            else
+            {
+                stack[stack_size++] = cur_node;
+                cur_node = cur_node->left;
+            }
+        }
+
+        if (stack_size == 0)
+            return;
+
+        cur_node = stack[--stack_size];
+
+        if (Before_(hi, cur_node->key))
+            return;
+
+        fn(cur_node->key);
+
+        cur_node = cur_node->right;
+    }
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+std::pair<Tree<KeyT, Comp, Alloc>, Tree<KeyT, Comp, Alloc>> Tree<KeyT, Comp, Alloc>::Split(const KeyT& key)
+{
+    SplitPieces_ pieces = SplitNodes_(TakeAll_(), key);
+
+    if (pieces.equal != nil_)
+        pieces.greater = JoinNodes_({nil_, 0}, pieces.equal, pieces.greater);
+
+    Tree less = Spawn_();
+    less.AdoptRoot_(pieces.less.root);
+
+    Tree rest = Spawn_();
+    rest.AdoptRoot_(pieces.greater.root);
+
+    return {std::move(less), std::move(rest)};
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc> Tree<KeyT, Comp, Alloc>::Join(Tree&& left, const KeyT& key, Tree&& right)
+{
+    RBT_ASSERT(left .empty() || left.Before_(left.back(), key));
+    RBT_ASSERT(right.empty() || left.Before_(key, right.front()));
+
+    Tree result = left.Spawn_();
+
+    Piece_ left_piece  = left.TakeAll_();
+    Piece_ right_piece = result.AdoptNodes_(right);
+
+    Node* key_node = result.CreateNode_(key, NodeColor::RED);
+
+#if RBT_THREADED
+    result.Link_((left_piece .root == result.nil_) ? result.nil_ : result.GetMax_(left_piece.root), key_node);
+    result.Link_(key_node, (right_piece.root == result.nil_) ? result.nil_ : result.GetMin_(right_piece.root));
+#endif
+
+    result.AdoptRoot_(result.JoinNodes_(left_piece, key_node, right_piece).root);
+
+    return result;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc> Tree<KeyT, Comp, Alloc>::Join(Tree&& left, Tree&& right)
+{
+    RBT_ASSERT(left.empty() || right.empty() || left.Before_(left.back(), right.front()));
+
+    Tree result = left.Spawn_();
+
+    Piece_ left_piece  = left.TakeAll_();
+    Piece_ right_piece = result.AdoptNodes_(right);
+
+#if RBT_THREADED
+    if (left_piece.root != result.nil_ && right_piece.root != result.nil_)
+        result.Link_(result.GetMax_(left_piece.root), result.GetMin_(right_piece.root));
+#endif
+
+    result.AdoptRoot_(result.Join2Nodes_(left_piece, right_piece).root);
+
+    return result;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::iterator Tree<KeyT, Comp, Alloc>::erase(const_iterator first, const_iterator last)
+{
+    if (first != last)
+        RemoveSubtree_(ExtractNodes_(first.node_ptr_, last.node_ptr_).root);
+
+    return CreateIterator(last.node_ptr_);
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+std::size_t Tree<KeyT, Comp, Alloc>::EraseRange(const KeyT& lo, const KeyT& hi)
+{
+    if (Compare_(lo, hi))
+        return 0;
+
+    Node* first = LowerBoundNode_(lo);
+    Node* last  = UpperBoundNode_(hi);
+
+    if (first == last)
+        return 0;
+
+    Node*       removed = ExtractNodes_(first, last).root;
+    std::size_t count   = removed->size;
+
+    RemoveSubtree_(removed);
+
+    return count;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc> Tree<KeyT, Comp, Alloc>::ExtractRange(const KeyT& lo, const KeyT& hi)
+{
+    Piece_ extracted = {nil_, 0};
+
+    if (!Compare_(lo, hi))
+    {
+        Node* first = LowerBoundNode_(lo);
+        Node* last  = UpperBoundNode_(hi);
+
+        if (first != last)
+            extracted = ExtractNodes_(first, last);
+    }
+
+    // an arena of its own, so the two trees may be written on different threads
+    Tree result = Spawn_();
+    result.AdoptRoot_(extracted.root);
+
+    return result;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc> Tree<KeyT, Comp, Alloc>::Union(Tree&& lhs, Tree&& rhs)
+{
+    Tree result = lhs.Spawn_();
+
+    Piece_ lhs_piece = lhs.TakeAll_();
+    Piece_ rhs_piece = result.AdoptNodes_(rhs);
+
+    std::vector<Node*> garbage;
+    Piece_ united = result.UnionNodes_(lhs_piece, rhs_piece, garbage, Parallel::ForkDepth());
+
+    result.FreeGarbage_(garbage);
+    result.AdoptRoot_(united.root);
+    result.ThreadSubtree_(result.root_);        // nodes of both trees interleave, RBT_THREADED links are rebuilt in O(n + m)
+
+    return result;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc> Tree<KeyT, Comp, Alloc>::Intersection(Tree&& lhs, Tree&& rhs)
+{
+    Tree result = lhs.Spawn_();
+
+    Piece_ lhs_piece = lhs.TakeAll_();
+    Piece_ rhs_piece = result.AdoptNodes_(rhs);
+
+    std::vector<Node*> garbage;
+    Piece_ common = result.IntersectionNodes_(lhs_piece, rhs_piece, garbage, Parallel::ForkDepth());
+
+    result.FreeGarbage_(garbage);
+    result.AdoptRoot_(common.root);
+    result.ThreadSubtree_(result.root_);
+
+    return result;
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc> Tree<KeyT, Comp, Alloc>::Difference(Tree&& lhs, Tree&& rhs)
+{
+    Tree result = lhs.Spawn_();
+
+    Piece_ lhs_piece = lhs.TakeAll_();
+    Piece_ rhs_piece = result.AdoptNodes_(rhs);
+
+    std::vector<Node*> garbage;
+    Piece_ rest = result.DifferenceNodes_(lhs_piece, rhs_piece, garbage, Parallel::ForkDepth());
+
+    result.FreeGarbage_(garbage);
+    result.AdoptRoot_(rest.root);
+    result.ThreadSubtree_(result.root_);
+
+    return result;
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+unsigned Tree<KeyT, Comp, Alloc>::BlackHeight_(Node* sub_root) const
+{
+    unsigned black_height = 0;
+
+    for (Node* cur_node = sub_root; cur_node != nil_; cur_node = cur_node->left)
+    {
+        if (cur_node->color == NodeColor::BLACK)
+            ++black_height;
+    }
+
+    return black_height;
+}
+
+// empty tree with the comparator of this one for nodes of this one: a fresh arena that adopts
+// the chunks of alloc_, so the two trees never share a free list
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc> Tree<KeyT, Comp, Alloc>::Spawn_() const
+{
+    if constexpr (requires (NodeAlloc alloc) { alloc.Adopt(alloc_); })
+    {
+        Tree spawned(NodeAllocTraits::select_on_container_copy_construction(alloc_));
+
+        spawned.comparator_ = comparator_;
+        spawned.alloc_.Adopt(alloc_);
+
+        return spawned;
+    }
+
+    else
+    {
+        Tree spawned(alloc_);
+
+        spawned.comparator_ = comparator_;
+
+        return spawned;
+    }
+}
+
+// detaches all nodes, the tree is left empty
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::TakeAll_()
+{
+    Piece_ all = {root_, BlackHeight_(root_)};
+
+    root_      = nil_;
+    leftmost_  = nil_;
+    rightmost_ = nil_;
+
+    return all;
+}
+
+// takes all nodes of other so that alloc_ may release them: as they are when both allocators
+// can release each other's nodes, otherwise the keys are moved into nodes from alloc_
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::AdoptNodes_(Tree& other)
+{
+    if constexpr (!NodeAllocTraits::is_always_equal::value)
+    {
+        if (alloc_ != other.alloc_)
+        {
+            if constexpr (requires { alloc_.Adopt(other.alloc_); })
+            {
+                alloc_.Adopt(other.alloc_);
+            }
+
+            else
+            {
+                std::vector<KeyT> keys;
+                keys.reserve(other.size());
+
+                for (KeyT& key : other)
+                    keys.push_back(std::move(key));
+
+                other.clear();
+
+                if (keys.empty())
+                    return {nil_, 0};
+
+                unsigned red_depth = static_cast<unsigned>(std::bit_width(keys.size()) - 1);
+
+                Node* root = BuildSubtree_(keys.data(), keys.size(), nil_, 0, red_depth);
+                root->color = NodeColor::BLACK;
+
+                ThreadSubtree_(root);
+
+                return {root, BlackHeight_(root)};
+            }
+        }
+    }
+
+    return other.TakeAll_();
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::AdoptRoot_(Node* root)
+{
+    RBT_ASSERT(root_ == nil_);
+
+    root_ = root;
+
+    if (root_ == nil_)
+        return;
+
+    root_->color  = NodeColor::BLACK;
+    root_->father = nil_;
+
+    leftmost_  = GetMin_(root_);
+    rightmost_ = GetMax_(root_);
+
+    // neighbours that stayed in another tree
+    Link_(nil_, leftmost_);
+    Link_(rightmost_, nil_);
+}
+
+// cuts the nodes from first up to last (nil_ for the end) out of the tree, first must precede last
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::ExtractNodes_(Node* first, Node* last)
+{
+    RBT_ASSERT(first != nil_);
+
+    // split keys stay valid: nodes are relinked, never moved or destroyed
+#if RBT_THREADED
+    Node* before = first->prev;
+#endif
+
+    SplitPieces_ below = SplitNodes_(TakeAll_(), first->key);
+    Piece_       from  = JoinNodes_({nil_, 0}, below.equal, below.greater);
+
+    Piece_ inside = from;
+    Piece_ above  = {nil_, 0};
+
+    if (last != nil_)
+    {
+        SplitPieces_ upto = SplitNodes_(from, last->key);
+
+        inside = upto.less;
+        above  = JoinNodes_({nil_, 0}, upto.equal, upto.greater);
+    }
+
+#if RBT_THREADED
+    Link_(before, last);
+#endif
+
+    AdoptRoot_(Join2Nodes_(below.less, above).root);
+
+    return inside;
+}
+
+// cuts child off the root of father
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::Detach_(Node* child, const Piece_& father)
+{
+    if (child != nil_)
+        child->father = nil_;
+
+    return {child, father.black_height - (father.root->color == NodeColor::BLACK ? 1 : 0)};
+}
+
+
+// Every key of left is less then key_node's key, every key of right is greater. The key node
+// goes down the spine of the higher tree to the black node as high as the other tree, then
+// the red-red conflict is fixed on the way up, O(difference of black heights + 1).
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::JoinNodes_(Piece_ left, Node* key_node, Piece_ right)
+{
+    for (Piece_* piece : {&left, &right})
+    {
+        if (piece->root->color == NodeColor::RED)
+        {
+            piece->root->color = NodeColor::BLACK;
+            ++piece->black_height;
+        }
+    }
+
+    key_node->color = NodeColor::RED;
+
+    if (left.black_height == right.black_height)
+    {
+        key_node->left   = left.root;
+        key_node->right  = right.root;
+        key_node->father = nil_;
+        key_node->size   = left.root->size + right.root->size + 1;
+
+        if (left.root != nil_)
+            left.root->father = key_node;
+
+        if (right.root != nil_)
+            right.root->father = key_node;
+
+        return {key_node, left.black_height};
+    }
+
+    bool     left_higher  = left.black_height > right.black_height;
+    Node*    root         = left_higher ? left.root : right.root;
+    Node*    lower_root   = left_higher ? right.root : left.root;
+    unsigned lower_height = left_higher ? right.black_height : left.black_height;
+    unsigned cur_height   = left_higher ? left.black_height : right.black_height;
+
+    Node* father   = nil_;
+    Node* cur_node = root;
+
+    // nil_ is black with height 0, so the walk always stops
+    while (cur_node->color == NodeColor::RED || cur_height != lower_height)
+    {
+        if (cur_node->color == NodeColor::BLACK)
+            --cur_height;
+
+        father   = cur_node;
+        cur_node = left_higher ? cur_node->right : cur_node->left;
+    }
+
+    key_node->left   = left_higher ? cur_node : lower_root;
+    key_node->right  = left_higher ? lower_root : cur_node;
+    key_node->father = father;
+    key_node->size   = cur_node->size + lower_root->size + 1;
+
+    if (cur_node != nil_)
+        cur_node->father = key_node;
+
+    if (lower_root != nil_)
+        lower_root->father = key_node;
+
+    if (left_higher)
+        father->right = key_node;
+
+    else
+        father->left = key_node;
+
+    UpdateSizesUpward_(father);
+    RBT_HANDLE(FixupRedRed_(key_node, root));
+
+    return {root, std::max(left.black_height, right.black_height)};
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::Join2Nodes_(Piece_ left, Piece_ right)
+{
+    if (left.root == nil_)
+        return right;
+
+    Node* last = nil_;
+    Piece_ rest = SplitLastNodes_(left, last);
+
+    return JoinNodes_(rest, last, right);
+}
+
+// detaches the maximum of sub_tree into last and returns the remaining keys
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::SplitLastNodes_(Piece_ sub_tree, Node*& last)
+{
+    Node* root = sub_tree.root;
+
+    Piece_ left  = Detach_(root->left,  sub_tree);
+    Piece_ right = Detach_(root->right, sub_tree);
+
+    if (right.root == nil_)
+    {
+        last = root;
+        return left;
+    }
+
+    Piece_ rest = SplitLastNodes_(right, last);
+
+    return JoinNodes_(left, root, rest);
+}
+
+// the nodes on the search path become the keys that join the pieces back
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::SplitPieces_ Tree<KeyT, Comp, Alloc>::SplitNodes_(Piece_ sub_tree, const KeyT& key)
+{
+    Node* root = sub_tree.root;
+
+    if (root == nil_)
+        return {{nil_, 0}, nil_, {nil_, 0}};
+
+    Piece_ left  = Detach_(root->left,  sub_tree);
+    Piece_ right = Detach_(root->right, sub_tree);
+
+    if (Before_(key, root->key))
+    {
+        SplitPieces_ pieces = SplitNodes_(left, key);
+        pieces.greater = JoinNodes_(pieces.greater, root, right);
+
+        return pieces;
+    }
+
+    if (Before_(root->key, key))
+    {
+        SplitPieces_ pieces = SplitNodes_(right, key);
+        pieces.less = JoinNodes_(left, root, pieces.less);
+
+        return pieces;
+    }
+
+    root->left   = nil_;
+    root->right  = nil_;
+    root->size   = 1;
+
+    return {left, root, right};
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::UnionNodes_(Piece_ lhs, Piece_ rhs, std::vector<Node*>& garbage,
+                                                                    unsigned fork_depth)
+{
+    if (lhs.root == nil_)
+        return rhs;
+
+    if (rhs.root == nil_)
+        return lhs;
+
+    std::size_t keys = lhs.root->size + rhs.root->size;
+    Node*       root = lhs.root;
+
+    Piece_       left   = Detach_(root->left,  lhs);
+    Piece_       right  = Detach_(root->right, lhs);
+    SplitPieces_ pieces = SplitNodes_(rhs, root->key);
+
+    if (pieces.equal != nil_)
+        garbage.push_back(pieces.equal);
+
+    RunBoth_(keys, fork_depth, garbage,
+             [&](std::vector<Node*>& task_garbage, unsigned depth) { left  = UnionNodes_(left,  pieces.less,    task_garbage, depth); },
+             [&](std::vector<Node*>& task_garbage, unsigned depth) { right = UnionNodes_(right, pieces.greater, task_garbage, depth); });
+
+    return JoinNodes_(left, root, right);
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::IntersectionNodes_(Piece_ lhs, Piece_ rhs, std::vector<Node*>& garbage,
+                                                                           unsigned fork_depth)
+{
+    if (lhs.root == nil_ || rhs.root == nil_)
+    {
+        for (Node* root : {lhs.root, rhs.root})
+        {
+            if (root != nil_)
+                garbage.push_back(root);
+        }
+
+        return {nil_, 0};
+    }
+
+    std::size_t keys = lhs.root->size + rhs.root->size;
+    Node*       root = lhs.root;
+
+    Piece_       left   = Detach_(root->left,  lhs);
+    Piece_       right  = Detach_(root->right, lhs);
+    SplitPieces_ pieces = SplitNodes_(rhs, root->key);
+
+    RunBoth_(keys, fork_depth, garbage,
+             [&](std::vector<Node*>& task_garbage, unsigned depth) { left  = IntersectionNodes_(left,  pieces.less,    task_garbage, depth); },
+             [&](std::vector<Node*>& task_garbage, unsigned depth) { right = IntersectionNodes_(right, pieces.greater, task_garbage, depth); });
+
+    if (pieces.equal != nil_)
+    {
+        garbage.push_back(pieces.equal);
+
+        return JoinNodes_(left, root, right);
+    }
+
+    root->left  = nil_;
+    root->right = nil_;
+    garbage.push_back(root);
+
+    return Join2Nodes_(left, right);
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+Tree<KeyT, Comp, Alloc>::Piece_ Tree<KeyT, Comp, Alloc>::DifferenceNodes_(Piece_ lhs, Piece_ rhs, std::vector<Node*>& garbage,
+                                                                         unsigned fork_depth)
+{
+    if (lhs.root == nil_ || rhs.root == nil_)
+    {
+        if (rhs.root != nil_)
+            garbage.push_back(rhs.root);
+
+        return lhs;
+    }
+
+    std::size_t keys = lhs.root->size + rhs.root->size;
+    Node*       root = rhs.root;
+
+    Piece_       left   = Detach_(root->left,  rhs);
+    Piece_       right  = Detach_(root->right, rhs);
+    SplitPieces_ pieces = SplitNodes_(lhs, root->key);
+
+    root->left  = nil_;
+    root->right = nil_;
+    garbage.push_back(root);
+
+    if (pieces.equal != nil_)
+        garbage.push_back(pieces.equal);
+
+    RunBoth_(keys, fork_depth, garbage,
+             [&](std::vector<Node*>& task_garbage, unsigned depth) { left  = DifferenceNodes_(pieces.less,    left,  task_garbage, depth); },
+             [&](std::vector<Node*>& task_garbage, unsigned depth) { right = DifferenceNodes_(pieces.greater, right, task_garbage, depth); });
+
+    return Join2Nodes_(left, right);
+}
+
+// the two halves touch disjoint nodes and never allocate, so they may run at once;
+// each half collects removed nodes in its own list
+template <typename KeyT, typename Comp, typename Alloc>
+template <typename LeftTask, typename RightTask>
+void Tree<KeyT, Comp, Alloc>::RunBoth_(std::size_t keys, unsigned fork_depth, std::vector<Node*>& garbage,
+                                       LeftTask left_task, RightTask right_task)
+{
+    if (fork_depth == 0 || keys < PARALLEL_MIN_KEYS)
+    {
+        left_task (garbage, 0);
+        right_task(garbage, 0);
+
+        return;
+    }
+
+    std::vector<Node*> left_garbage;
+
+    Parallel::ForkJoin([&] { left_task(left_garbage, fork_depth - 1); },
+                       [&] { right_task(garbage,     fork_depth - 1); });
+
+    garbage.insert(garbage.end(), left_garbage.begin(), left_garbage.end());
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::FreeGarbage_(std::vector<Node*>& garbage)
+{
+    for (Node* sub_root : garbage)
+        RBT_HANDLE(RemoveSubtree_(sub_root));
+
+    garbage.clear();
+}
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+TreeStats Tree<KeyT, Comp, Alloc>::Stats() const
+{
+#if RBT_STATS
+    return stats_.Snapshot();
+#else
+    return {};
+#endif
+}
+
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::ResetStats()
+{
+#if RBT_STATS
+    stats_.Reset();
+#endif
+}
+
+#if RBT_STATS
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::DumpStats() const
+{
+    TreeStats stats = Stats();
+
+    RLSU_INFO("tree stats: {} keys, height {}, black height {}", size(), Height(), BlackHeight());
+    RLSU_INFO("  comparisons {}, rotations {} left + {} right", stats.comparisons, stats.left_rotations, stats.right_rotations);
+    RLSU_INFO("  insert fixups {} ({} iterations), delete fixups {} ({} iterations)",
+              stats.insert_fixups, stats.insert_fixup_iterations, stats.delete_fixups, stats.delete_fixup_iterations);
+    RLSU_INFO("  descents {} ({} nodes), climbs {}", stats.descents, stats.descent_nodes, stats.climbs);
+
+    std::vector<std::size_t> histogram = DepthHistogram();
+
+    for (std::size_t depth = 0; depth < histogram.size(); ++depth)
+        RLSU_INFO("  depth {}: {} keys", depth, histogram[depth]);
+}
+#endif
+
+// level by level, so a degenerate tree costs memory for its widest level only
+template <typename KeyT, typename Comp, typename Alloc>
+std::vector<std::size_t> Tree<KeyT, Comp, Alloc>::DepthHistogram() const
+{
+    std::vector<std::size_t> histogram;
+    std::vector<Node*>       level;
+    std::vector<Node*>       next_level;
+
+    if (root_ != nil_)
+        level.push_back(root_);
+
+    while (!level.empty())
+    {
+        histogram.push_back(level.size());
+        next_level.clear();
+
+        for (Node* node : level)
+        {
+            if (node->left != nil_)
+                next_level.push_back(node->left);
+
+            if (node->right != nil_)
+                next_level.push_back(node->right);
+        }
+
+        level.swap(next_level);
+    }
+
+    return histogram;
+}
+
+
+
+template <typename KeyT, typename Comp, typename Alloc>
+bool Tree<KeyT, Comp, Alloc>::IsValid() const
+{
+    if (root_ == nil_)
+        return leftmost_ == nil_ && rightmost_ == nil_;
+
+    const Node* prev = nil_;
+
+    return root_->color == NodeColor::BLACK && root_->father == nil_ &&
+           ValidSubtree_(root_, prev) >= 0 &&
+           leftmost_ == GetMin_(root_) && rightmost_ == GetMax_(root_);
+}
+
+// in order, so prev is the previous node and the keys must grow strictly
+template <typename KeyT, typename Comp, typename Alloc>
+int Tree<KeyT, Comp, Alloc>::ValidSubtree_(const Node* sub_root, const Node*& prev) const
+{
+    if (sub_root == nil_)
+        return 0;
+
+    const Node* left  = sub_root->left;
+    const Node* right = sub_root->right;
+
+    if ((left != nil_ && left->father != sub_root) || (right != nil_ && right->father != sub_root))
+        return -1;
+
+    if (sub_root->color == NodeColor::RED && (left->color == NodeColor::RED || right->color == NodeColor::RED))
+        return -1;
+
+    if (sub_root->size != left->size + right->size + 1)
+        return -1;
+
+    int left_height = ValidSubtree_(left, prev);
+
+    if (left_height < 0 || (prev != nil_ && !Before_(prev->key, sub_root->key)))
+        return -1;
+
+#if RBT_THREADED
+    if (sub_root->prev != prev || (prev != nil_ && prev->next != sub_root))
+        return -1;
+#endif
+
+    prev = sub_root;
+
+    int right_height = ValidSubtree_(right, prev);
+
+    if (right_height != left_height)
+        return -1;
+
+    return left_height + (sub_root->color == NodeColor::BLACK ? 1 : 0);
+}
 
 #ifndef NDEBUG
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::Dump() const
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::Dump() const
 {
     RLSU::Graphics::Graph graph(
         [](size_t graph_size) -> size_t {
@@ -671,8 +2387,8 @@ void Tree<KeyT, Comp>::Dump() const
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::AddConfiduredGraphNode_(RLSU::Graphics::Graph& graph, const Node* node) const
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::AddConfiduredGraphNode_(RLSU::Graphics::Graph& graph, const Node* node) const
 {
     RLSU::Graphics::Graph::Node new_graph_node(node);
 
@@ -696,48 +2412,50 @@ void Tree<KeyT, Comp>::AddConfiduredGraphNode_(RLSU::Graphics::Graph& graph, con
 }
 
 
-template <typename KeyT, typename Comp>
-void Tree<KeyT, Comp>::AddNodeEdges_(RLSU::Graphics::Graph& graph, const Node* node) const
+template <typename KeyT, typename Comp, typename Alloc>
+void Tree<KeyT, Comp, Alloc>::AddNodeEdges_(RLSU::Graphics::Graph& graph, const Node* node) const
 {
     if (node->left != nil_)
     {
-        ERROR_HANDLE(graph.AddEdge(node, node->left, "l"));
+        RBT_HANDLE(graph.AddEdge(node, node->left, "l"));
     }
 
     else
     {
-        // ERROR_HANDLE(graph.AddEdge(node, node->left, "l"));
+        // RBT_HANDLE(graph.AddEdge(node, node->left, "l"));
         RLSU::Graphics::Graph::Node fictive_nil((void*)((size_t)node >> 2));
 
         fictive_nil.SetColor(graph.BACKGROWND_COLOR);
         fictive_nil.SetBorderColor(graph.BACKGROWND_COLOR);
         fictive_nil.SetLabel("");
-        ERROR_HANDLE(graph.AddNode(fictive_nil));
+        RBT_HANDLE(graph.AddNode(fictive_nil));
 
-        ERROR_HANDLE(graph.AddEdge(node, fictive_nil.OwnerPtr, "l"));
+        RBT_HANDLE(graph.AddEdge(node, fictive_nil.OwnerPtr, "l"));
     }
     
 
     if (node->right != nil_)
     {
-        ERROR_HANDLE(graph.AddEdge(node, node->right, "r"));
+        RBT_HANDLE(graph.AddEdge(node, node->right, "r"));
     }
 
     else
     {
-        // ERROR_HANDLE(graph.AddEdge(node, node->right, "r"));
+        // RBT_HANDLE(graph.AddEdge(node, node->right, "r"));
 
         RLSU::Graphics::Graph::Node fictive_nil((void*)(((size_t)node >> 3)));
 
         fictive_nil.SetColor(graph.BACKGROWND_COLOR);
         fictive_nil.SetBorderColor(graph.BACKGROWND_COLOR);
         fictive_nil.SetLabel("");
-        ERROR_HANDLE(graph.AddNode(fictive_nil));
+        RBT_HANDLE(graph.AddNode(fictive_nil));
 
-        ERROR_HANDLE(graph.AddEdge(node, fictive_nil.OwnerPtr, "r"));
+        RBT_HANDLE(graph.AddEdge(node, fictive_nil.OwnerPtr, "r"));
     }
 }
 
 #endif
 
-}
\ No newline at end of file
+}
+// Save, Open and Load are defined there, after FrozenTree
+#include "RedBlackTree/frozen_tree.hpp"
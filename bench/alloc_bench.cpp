@@ -0,0 +1,101 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "RedBlackTree/tree.hpp"
+
+// Compares the default arena node allocator against std::allocator.
+// usage: alloc_bench [keys] [churn_ops]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::vector<int> RandomKeys(std::size_t count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<int> keys(count);
+
+    for (int& key : keys)
+        key = static_cast<int>(rng());
+
+    return keys;
+}
+
+template <typename TreeT>
+void InsertHeavy(const char* name, const std::vector<int>& keys)
+{
+    auto start = Clock::now();
+
+    {
+        TreeT tree;
+
+        for (int key : keys)
+            tree.insert(key);
+    }
+
+    double ms = MsSince(start);
+
+    std::printf("%-16s insert-heavy  %10zu keys  %9.2f ms  %7.1f ns/key\n",
+                name, keys.size(), ms, ms * 1e6 / static_cast<double>(keys.size()));
+}
+
+template <typename TreeT>
+void ChurnHeavy(const char* name, const std::vector<int>& keys, std::size_t ops)
+{
+    TreeT tree;
+
+    for (int key : keys)
+        tree.insert(key);
+
+    std::vector<int> live = keys;
+    std::mt19937     rng(42);
+
+    auto start = Clock::now();
+
+    for (std::size_t i = 0; i < ops; ++i)
+    {
+        std::size_t victim = rng() % live.size();
+
+        tree.erase(live[victim]);
+        live[victim] = static_cast<int>(rng());
+        tree.insert(live[victim]);
+    }
+
+    double ms = MsSince(start);
+
+    std::size_t checksum = 0;
+    for (std::size_t i = 0; i < keys.size(); i += 64)
+        checksum += tree.Rank(keys[i]);
+
+    std::printf("%-16s churn-heavy   %10zu ops   %9.2f ms  %7.1f ns/op   (checksum %zu)\n",
+                name, ops, ms, ms * 1e6 / static_cast<double>(ops), checksum);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t key_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t churn_ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : key_count;
+
+    using ArenaTree = Trees::RBT::Tree<int, std::greater<int>>;
+    using HeapTree  = Trees::RBT::Tree<int, std::greater<int>, std::allocator<int>>;
+
+    std::vector<int> keys = RandomKeys(key_count, 1);
+
+    InsertHeavy<ArenaTree>("arena",          keys);
+    InsertHeavy<HeapTree> ("std::allocator", keys);
+
+    ChurnHeavy<ArenaTree>("arena",          keys, churn_ops);
+    ChurnHeavy<HeapTree> ("std::allocator", keys, churn_ops);
+}
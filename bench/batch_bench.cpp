@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "RedBlackTree/tree.hpp"
+
+// Compares Tree::InsertBatch with a plain insert loop on random, sorted and clustered batches.
+// usage: batch_bench [base_keys] [batch_size] [batches]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Tree  = Trees::RBT::Tree<int, std::greater<int>>;
+
+enum class Pattern { RANDOM, SORTED, CLUSTERED };
+
+const char* PatternName(Pattern pattern)
+{
+    switch (pattern)
+    {
+        case Pattern::RANDOM:    return "random";
+        case Pattern::SORTED:    return "sorted";
+        case Pattern::CLUSTERED: return "clustered";
+    }
+
+    return "?";
+}
+
+std::vector<std::vector<int>> MakeBatches(Pattern pattern, std::size_t batch_size, std::size_t batches, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<std::vector<int>> result(batches, std::vector<int>(batch_size));
+
+    for (std::vector<int>& batch : result)
+    {
+        int center = static_cast<int>(rng() >> 1);
+
+        for (int& key : batch)
+        {
+            if (pattern == Pattern::CLUSTERED)
+                key = center + static_cast<int>(rng() % (batch_size * 16));
+
+            else
+                key = static_cast<int>(rng());
+        }
+
+        if (pattern == Pattern::SORTED)
+            std::sort(batch.begin(), batch.end());
+    }
+
+    return result;
+}
+
+template <typename InsertFunc>
+double Run(const Tree& base, const std::vector<std::vector<int>>& batches, InsertFunc insert_batch, std::size_t& checksum)
+{
+    Tree tree = base;
+
+    auto start = Clock::now();
+
+    for (const std::vector<int>& batch : batches)
+        insert_batch(tree, batch);
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    checksum += tree.size();
+
+    return ns / static_cast<double>(batches.size() * batches.front().size());
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t base_keys  = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t batch_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4096;
+    std::size_t batches    = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 64;
+
+    std::mt19937 rng(1);
+    std::vector<int> base_keys_vec(base_keys);
+    for (int& key : base_keys_vec)
+        key = static_cast<int>(rng());
+
+    Tree base(base_keys_vec.begin(), base_keys_vec.end());
+
+    std::size_t checksum = 0;
+
+    for (Pattern pattern : {Pattern::RANDOM, Pattern::SORTED, Pattern::CLUSTERED})
+    {
+        std::vector<std::vector<int>> work = MakeBatches(pattern, batch_size, batches, 2);
+
+        double loop_ns = Run(base, work, [](Tree& tree, const std::vector<int>& batch)
+        {
+            for (int key : batch)
+                tree.insert(key);
+        }, checksum);
+
+        double batch_ns = Run(base, work, [](Tree& tree, const std::vector<int>& batch)
+        {
+            tree.InsertBatch(batch);
+        }, checksum);
+
+        std::printf("%-10s batch %zu x %zu on %zu keys:  insert loop %7.1f ns/key  InsertBatch %7.1f ns/key\n",
+                    PatternName(pattern), batches, batch_size, base_keys, loop_ns, batch_ns);
+    }
+
+    std::printf("(checksum %zu)\n", checksum);
+}
@@ -0,0 +1,96 @@
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "RedBlackTree/compact_tree.hpp"
+#include "RedBlackTree/tree.hpp"
+
+// Memory and lookup speed of the index-linked CompactTree against the pointer-linked Tree
+// at sizes 1M, 10M, ... up to max_keys. bytes/key is the heap growth while building, as
+// reported by mallinfo2(), so it includes the arena chunks of Tree and the spare capacity
+// of the CompactTree array. CompactTree is built twice: by random inserts (nodes in
+// insertion order) and by BulkLoad (nodes in key order).
+// usage: compact_bench [max_keys] [queries]
+
+namespace {
+
+using Clock       = std::chrono::steady_clock;
+using Tree        = Trees::RBT::Tree<int, std::greater<int>>;
+using CompactTree = Trees::RBT::CompactTree<int, std::greater<int>>;
+
+std::size_t checksum = 0;
+
+std::size_t HeapBytes()
+{
+    struct mallinfo2 info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+}
+
+template <typename Fn>
+double NsPerOp(std::size_t ops, Fn fn)
+{
+    auto start = Clock::now();
+
+    fn();
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    return ns / static_cast<double>(ops == 0 ? 1 : ops);
+}
+
+template <typename TreeT, typename Build>
+void Run(const char* name, const std::vector<int>& queries, Build build)
+{
+    std::size_t heap_before = HeapBytes();
+
+    TreeT tree;
+
+    double build_ns = NsPerOp(1, [&] { build(tree); });
+
+    double bytes_per_key = static_cast<double>(HeapBytes() - heap_before) / static_cast<double>(tree.size());
+
+    double lower_bound_ns = NsPerOp(queries.size(), [&]
+    {
+        for (int query : queries)
+        {
+            auto it = tree.LowerBound(query);
+            checksum += (it == tree.end()) ? 0 : static_cast<unsigned>(*it);
+        }
+    });
+
+    std::printf("%-22s %11zu keys %8.1f bytes/key %8.1f ns/key build %8.1f ns LowerBound\n",
+                name, tree.size(), bytes_per_key, build_ns / static_cast<double>(tree.size()), lower_bound_ns);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t max_keys    = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    std::size_t query_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+
+    for (std::size_t key_count = 1'000'000; key_count <= max_keys; key_count *= 10)
+    {
+        std::mt19937 rng(static_cast<unsigned>(key_count));
+
+        std::vector<int> keys(key_count);
+        for (int& key : keys)
+            key = static_cast<int>(rng() >> 1);
+
+        std::vector<int> queries(query_count);
+        for (int& query : queries)
+            query = static_cast<int>(rng() >> 1);
+
+        Run<Tree>       ("Tree, inserts",        queries, [&](Tree& tree)        { for (int key : keys) tree.insert(key); });
+        Run<CompactTree>("CompactTree, inserts", queries, [&](CompactTree& tree) { for (int key : keys) tree.insert(key); });
+        Run<CompactTree>("CompactTree, BulkLoad", queries, [&](CompactTree& tree) { tree.BulkLoad(keys.begin(), keys.end()); });
+    }
+
+    std::printf("(checksum %zu)\n", checksum);
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "RedBlackTree/concurrent_tree.hpp"
+#include "RedBlackTree/parallel.hpp"
+#include "RedBlackTree/tree.hpp"
+
+// Throughput of ConcurrentTree against a Tree behind one std::mutex for read:write mixes
+// from 100:0 to 50:50 and thread counts from 1 up to max_threads. Reads are CountInRange,
+// writes alternate insert and erase of random keys.
+// usage: concurrent_bench [keys] [ops_per_thread] [max_threads]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Tree  = Trees::RBT::Tree<int, std::greater<int>>;
+using Conc  = Trees::RBT::ConcurrentTree<int, std::greater<int>>;
+
+struct LockedTree
+{
+    Tree       tree  = {};
+    std::mutex mutex = {};
+
+    std::size_t CountInRange(int lo, int hi) { std::lock_guard<std::mutex> lock(mutex); return tree.CountInRange(lo, hi); }
+    void        insert      (int key)        { std::lock_guard<std::mutex> lock(mutex); tree.insert(key); }
+    void        erase       (int key)        { std::lock_guard<std::mutex> lock(mutex); tree.erase(key); }
+};
+
+constexpr int KEY_RANGE = 1 << 30;
+constexpr int QUERY_LEN = 1 << 16;
+
+// returns millions of operations per second over all threads
+template <typename Shared>
+double Run(Shared& shared, std::size_t threads, std::size_t ops_per_thread, unsigned write_percent, std::atomic<std::size_t>& checksum)
+{
+    std::atomic<std::size_t> ready = 0;
+    std::atomic<bool>        go    = false;
+
+    std::vector<std::thread> workers;
+
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]
+        {
+            std::mt19937 rng(static_cast<unsigned>(t + 1));
+            std::size_t  local_sum = 0;
+
+            ready++;
+            while (!go)
+                std::this_thread::yield();
+
+            for (std::size_t op = 0; op < ops_per_thread; ++op)
+            {
+                int key = static_cast<int>(rng() % KEY_RANGE);
+
+                if (rng() % 100 < write_percent)
+                {
+                    if (op % 2 == 0)
+                        shared.insert(key);
+
+                    else
+                        shared.erase(key);
+                }
+
+                else
+                {
+                    local_sum += shared.CountInRange(key, key + QUERY_LEN);
+                }
+            }
+
+            checksum += local_sum;
+        });
+    }
+
+    while (ready != threads)
+        std::this_thread::yield();
+
+    auto start = Clock::now();
+    go = true;
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return static_cast<double>(threads * ops_per_thread) / seconds / 1e6;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t keys           = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t ops_per_thread = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200'000;
+    std::size_t max_threads    = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : Trees::RBT::Parallel::HardwareThreads();
+
+    std::mt19937 rng(1);
+    std::vector<int> initial(keys);
+    for (int& key : initial)
+        key = static_cast<int>(rng() % KEY_RANGE);
+
+    // powers of two below max_threads, then max_threads itself
+    std::vector<std::size_t> thread_counts;
+    for (std::size_t threads = 1; threads < max_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(std::max<std::size_t>(max_threads, 1));
+
+    std::atomic<std::size_t> checksum = 0;
+
+    std::printf("%zu keys, %zu ops per thread, Mops/s\n", keys, ops_per_thread);
+    std::printf("%-10s %8s %14s %14s\n", "read:write", "threads", "mutex+Tree", "ConcurrentTree");
+
+    for (unsigned write_percent : {0u, 5u, 10u, 25u, 50u})
+    {
+        for (std::size_t threads : thread_counts)
+        {
+            LockedTree locked;
+            locked.tree.BulkLoad(initial.begin(), initial.end());
+
+            Conc concurrent(initial.begin(), initial.end());
+
+            double locked_mops     = Run(locked,     threads, ops_per_thread, write_percent, checksum);
+            double concurrent_mops = Run(concurrent, threads, ops_per_thread, write_percent, checksum);
+
+            std::printf("%3u:%-6u %8zu %14.2f %14.2f\n", 100 - write_percent, write_percent,
+                        threads, locked_mops, concurrent_mops);
+        }
+    }
+
+    std::printf("(checksum %zu)\n", checksum.load());
+}
@@ -0,0 +1,142 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "RedBlackTree/tree.hpp"
+
+// Cold start from a Tree::Save file against rebuilding by inserts: Save, Open (mapping and
+// first lookup, page cache dropped for the file beforehand), lookups served from the
+// mapping, and Load into a mutable tree.
+// usage: file_bench [keys] [queries] [path]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Tree  = Trees::RBT::Tree<int, std::greater<int>>;
+
+double MsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// clean pages of the file leave the page cache, so the next mapping reads the disk
+void DropCache(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return;
+
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t key_count   = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    std::size_t query_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+    std::string path        = argc > 3 ? argv[3] : "file_bench.rbt";
+
+    std::mt19937 rng(1);
+
+    std::vector<int> keys(key_count);
+    for (int& key : keys)
+        key = static_cast<int>(rng() >> 1);
+
+    std::vector<int> queries(query_count);
+    for (int& query : queries)
+        query = keys[rng() % key_count];
+
+    std::size_t checksum = 0;
+
+    auto start = Clock::now();
+
+    Tree tree;
+    for (int key : keys)
+        tree.insert(key);
+
+    double insert_ms = MsSince(start);
+
+    start = Clock::now();
+
+    std::error_code error;
+
+    if (!tree.Save(path, error))
+    {
+        std::fprintf(stderr, "file_bench: cannot save %s: %s\n", path.c_str(), error.message().c_str());
+        return 1;
+    }
+
+    double save_ms = MsSince(start);
+
+    DropCache(path);
+
+    start = Clock::now();
+
+    auto mapped = Tree::Open(path, error);
+
+    if (!mapped)
+    {
+        std::fprintf(stderr, "file_bench: cannot open %s: %s\n", path.c_str(), error.message().c_str());
+        return 1;
+    }
+
+    checksum += mapped->CountInRange(queries[0], queries[0] + 1024);
+
+    double open_ms = MsSince(start);
+
+    start = Clock::now();
+
+    for (int query : queries)
+        checksum += mapped->CountInRange(query, query + 1024);
+
+    double mapped_query_ns = MsSince(start) * 1e6 / static_cast<double>(query_count);
+
+    start = Clock::now();
+
+    for (int query : queries)
+        checksum += tree.CountInRange(query, query + 1024);
+
+    double tree_query_ns = MsSince(start) * 1e6 / static_cast<double>(query_count);
+
+    DropCache(path);
+
+    start = Clock::now();
+
+    auto loaded = Tree::Load(path, error);
+
+    double load_ms = MsSince(start);
+
+    if (!loaded)
+    {
+        std::fprintf(stderr, "file_bench: cannot load %s: %s\n", path.c_str(), error.message().c_str());
+        return 1;
+    }
+
+    checksum += loaded->size();
+
+    struct stat info = {};
+
+    double file_mib = (::stat(path.c_str(), &info) == 0) ? static_cast<double>(info.st_size) / (1 << 20) : 0;
+
+    std::printf("%zu keys, file %.1f MiB\n", tree.size(), file_mib);
+    std::printf("rebuild by insert %10.1f ms\n", insert_ms);
+    std::printf("Save              %10.1f ms\n", save_ms);
+    std::printf("Open + 1st query  %10.3f ms (cold page cache)\n", open_ms);
+    std::printf("Load (mutable)    %10.1f ms (cold page cache)\n", load_ms);
+    std::printf("CountInRange      %10.1f ns mapped, %.1f ns tree\n", mapped_query_ns, tree_query_ns);
+    std::printf("(checksum %zu)\n", checksum);
+
+    ::unlink(path.c_str());
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "RedBlackTree/frozen_tree.hpp"
+#include "RedBlackTree/tree.hpp"
+
+// Range-count and lower bound on the pointer tree against its FrozenTree snapshot, plus
+// the cost of freezing and of converting back. The same source is built twice:
+// frozen_bench for the baseline instruction set (SSE2 on x86-64) and frozen_bench_avx2 with -mavx2.
+// usage: frozen_bench [max_keys] [queries]
+
+namespace {
+
+using Clock      = std::chrono::steady_clock;
+using Tree       = Trees::RBT::Tree<int, std::greater<int>>;
+using FrozenTree = Trees::RBT::FrozenTree<int, std::greater<int>>;
+
+#if defined(__AVX2__)
+constexpr const char* SIMD_NAME = "AVX2";
+#elif defined(__SSE2__)
+constexpr const char* SIMD_NAME = "SSE2";
+#else
+constexpr const char* SIMD_NAME = "scalar";
+#endif
+
+template <typename Fn>
+double Ns(Fn fn)
+{
+    auto start = Clock::now();
+
+    fn();
+
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t max_keys    = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 23;
+    std::size_t query_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+
+    std::size_t checksum = 0;
+
+    std::printf("%s, lookups in ns per query, conversions in ms\n", SIMD_NAME);
+    std::printf("%10s %8s %8s %8s %12s %12s %12s %12s %12s\n", "keys", "freeze", "ToTree", "MiB",
+                "tree LB", "frozen LB", "tree count", "tree batch", "frozen count");
+
+    std::vector<std::size_t> sizes;
+    for (std::size_t keys = 1 << 16; keys < max_keys; keys *= 16)
+        sizes.push_back(keys);
+    sizes.push_back(max_keys);
+
+    for (std::size_t key_count : sizes)
+    {
+        std::mt19937 rng(1);
+        Tree tree;
+
+        // random insertion order scatters tree neighbours over memory
+        for (std::size_t i = 0; i < key_count; ++i)
+            tree.insert(static_cast<int>(rng() >> 1));
+
+        std::vector<int>                 queries(query_count);
+        std::vector<std::pair<int, int>> ranges (query_count);
+        std::vector<std::size_t>         counts (query_count);
+
+        for (std::size_t i = 0; i < query_count; ++i)
+        {
+            queries[i] = static_cast<int>(rng() >> 1);
+            ranges[i]  = {queries[i], queries[i] + (1 << 20)};
+        }
+
+        FrozenTree frozen;
+
+        double freeze_ns = Ns([&] { frozen = FrozenTree(tree); });
+        double thaw_ns   = Ns([&] { checksum += frozen.ToTree().size(); });
+
+        double tree_lb = Ns([&]
+        {
+            for (int query : queries)
+            {
+                auto it = tree.LowerBound(query);
+                checksum += it == tree.end() ? 0 : static_cast<unsigned>(*it);
+            }
+        });
+
+        double frozen_lb = Ns([&]
+        {
+            for (int query : queries)
+            {
+                auto it = frozen.LowerBound(query);
+                checksum += it == frozen.end() ? 0 : static_cast<unsigned>(*it);
+            }
+        });
+
+        double tree_count = Ns([&]
+        {
+            for (auto [lo, hi] : ranges)
+                checksum += tree.CountInRange(lo, hi);
+        });
+
+        double tree_batch = Ns([&] { tree.CountInRangeBatch(ranges, counts); });
+
+        for (std::size_t count : counts)
+            checksum += count;
+
+        double frozen_count = Ns([&] { frozen.CountInRangeBatch(ranges, counts); });
+
+        for (std::size_t count : counts)
+            checksum += count;
+
+        double queries_n = static_cast<double>(query_count);
+        double mib       = static_cast<double>(frozen.size() * sizeof(int)) * 17.0 / 16.0 / (1 << 20);
+
+        std::printf("%10zu %8.1f %8.1f %8.1f %12.1f %12.1f %12.1f %12.1f %12.1f\n", tree.size(), freeze_ns / 1e6, thaw_ns / 1e6, mib,
+                    tree_lb / queries_n, frozen_lb / queries_n, tree_count / queries_n, tree_batch / queries_n, frozen_count / queries_n);
+    }
+
+    std::printf("(checksum %zu)\n", checksum);
+}
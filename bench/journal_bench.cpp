@@ -0,0 +1,149 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "RedBlackTree/journal.hpp"
+
+// Journal append throughput on the disk holding path: buffered appends with group commit,
+// a wait for durability after every record from one thread (one fdatasync per record), and
+// the same from several threads, where group commit lets the waiters share syncs. Then
+// recovery: Journal::Replay (sort, reduce, Difference and Union) against applying the
+// records one by one in journal order.
+// usage: journal_bench [records] [threads] [path]
+
+namespace {
+
+using Clock   = std::chrono::steady_clock;
+using Tree    = Trees::RBT::Tree<int, std::greater<int>>;
+using Journal = Trees::RBT::Journal<int>;
+using Op      = Journal::Op;
+
+struct Record
+{
+    Op  op;
+    int key;
+};
+
+double MsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// appends records[first, first + count) from each of `threads` threads, waiting for each one if wait_each
+void RunAppends(const std::string& path, const char* name, const std::vector<Record>& records,
+                std::size_t count, unsigned threads, bool wait_each)
+{
+    ::unlink(path.c_str());
+
+    std::error_code          error;
+    std::unique_ptr<Journal> journal = Journal::Open(path, error);
+
+    if (!journal)
+    {
+        std::fprintf(stderr, "journal_bench: cannot open %s: %s\n", path.c_str(), error.message().c_str());
+        std::exit(1);
+    }
+
+    auto start = Clock::now();
+
+    std::vector<std::thread> workers;
+
+    for (unsigned thread = 0; thread < threads; ++thread)
+        workers.emplace_back([&, thread]
+        {
+            for (std::size_t i = thread * count; i < (thread + 1) * count; ++i)
+            {
+                std::uint64_t seq = journal->Append(records[i].op, records[i].key);
+
+                if (wait_each)
+                    journal->WaitDurable(seq);
+            }
+        });
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    if (!journal->Sync())
+    {
+        std::fprintf(stderr, "journal_bench: cannot write %s: %s\n", path.c_str(), journal->Error().message().c_str());
+        std::exit(1);
+    }
+
+    double      ms      = MsSince(start);
+    std::size_t total   = count * threads;
+    auto        syncs   = journal->SyncCount();
+
+    std::printf("%-28s %9zu records %10.0f records/s %8llu syncs %8.1f records/sync\n",
+                name, total, static_cast<double>(total) * 1e3 / ms, static_cast<unsigned long long>(syncs),
+                static_cast<double>(total) / static_cast<double>(syncs == 0 ? 1 : syncs));
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t record_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000;
+    unsigned    threads      = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 8;
+    std::string path         = argc > 3 ? argv[3] : "journal_bench.log";
+
+    std::mt19937 rng(1);
+
+    // three inserts per erase over a key space of twice the record count
+    std::vector<Record> records(record_count);
+    for (Record& record : records)
+        record = {rng() % 4 == 0 ? Op::ERASE : Op::INSERT, static_cast<int>(rng() % (2 * record_count))};
+
+    // waiting for every record costs a sync each, so those runs get fewer records
+    std::size_t waited = std::min<std::size_t>(record_count, 2000);
+
+    RunAppends(path, "append, group commit",   records, record_count,     1,       false);
+    RunAppends(path, "append + wait, 1 thread", records, waited,           1,       true);
+    RunAppends(path, "append + wait, threads",  records, waited / threads, threads, true);
+
+    // recovery of the full record list
+    RunAppends(path, "append for replay", records, record_count, 1, false);
+
+    auto start = Clock::now();
+
+    Tree                       replayed;
+    std::error_code            error;
+    std::optional<std::size_t> read = Journal::Replay(path, replayed, error);
+
+    if (!read)
+    {
+        std::fprintf(stderr, "journal_bench: cannot replay %s: %s\n", path.c_str(), error.message().c_str());
+        return 1;
+    }
+
+    double replay_ms = MsSince(start);
+
+    start = Clock::now();
+
+    Tree applied;
+    for (const Record& record : records)
+    {
+        if (record.op == Op::INSERT)
+            applied.insert(record.key);
+        else
+            applied.erase(record.key);
+    }
+
+    double apply_ms = MsSince(start);
+
+    bool same = replayed.size() == applied.size() && std::equal(replayed.begin(), replayed.end(), applied.begin());
+
+    std::printf("Replay (file, sort, bulk)    %10.1f ms for %zu records, %zu keys\n", replay_ms, *read, replayed.size());
+    std::printf("apply one by one (memory)    %10.1f ms%s\n", apply_ms, same ? "" : "  MISMATCH");
+
+    ::unlink(path.c_str());
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "RedBlackTree/tree.hpp"
+
+// Lookup cost of the descent kernel on trees from cache-resident to well above the last
+// level cache. The same source is built twice: lookup_bench with the software prefetches
+// and lookup_bench_noprefetch with RBT_PREFETCH=0.
+// "latency" chains every lookup on the result of the previous one, "throughput" lets the
+// CPU overlap independent lookups, the batch columns hand all queries to one batched call.
+// usage: lookup_bench [max_keys] [queries]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Tree  = Trees::RBT::Tree<int, std::greater<int>>;
+
+volatile int runtime_zero = 0;      // keeps the chained lookups dependent without changing them
+
+template <typename Lookup>
+double NsPerLookup(const std::vector<int>& queries, Lookup lookup, bool chained, std::size_t& checksum)
+{
+    int zero = runtime_zero;
+    int prev = 0;
+
+    auto start = Clock::now();
+
+    for (int query : queries)
+    {
+        prev = lookup(chained ? query + (prev & zero) : query);
+        checksum += static_cast<unsigned>(prev);
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    return ns / static_cast<double>(queries.size());
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t max_keys    = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 23;
+    std::size_t query_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+
+    std::size_t checksum = 0;
+
+    std::printf("RBT_PREFETCH=%d, ns per lookup\n", RBT_PREFETCH);
+    std::printf("%10s %8s %12s %12s %12s %12s %14s %14s %12s %12s\n", "keys", "MiB", "find lat", "find thr",
+                "LowerBound", "CountInRange", "insert(dup)", "std::set find", "FindBatch", "CountBatch");
+
+    std::vector<std::size_t> sizes;
+    for (std::size_t keys = 1 << 16; keys < max_keys; keys *= 16)
+        sizes.push_back(keys);
+    sizes.push_back(max_keys);
+
+    for (std::size_t key_count : sizes)
+    {
+        std::mt19937 rng(1);
+        std::vector<int> keys(key_count);
+        for (int& key : keys)
+            key = static_cast<int>(rng() >> 1);
+
+        // random insertion order scatters tree neighbours over memory
+        Tree          tree;
+        std::set<int> reference;
+
+        for (int key : keys)
+        {
+            tree.insert(key);
+            reference.insert(key);
+        }
+
+        std::vector<int> queries(query_count);
+        for (int& query : queries)
+            query = keys[rng() % key_count];
+
+        auto find = [&](int key)
+        {
+            auto it = tree.find(key);
+            return it == tree.end() ? 0 : *it;
+        };
+
+        double find_latency    = NsPerLookup(queries, find, true,  checksum);
+        double find_throughput = NsPerLookup(queries, find, false, checksum);
+
+        double lower_bound = NsPerLookup(queries, [&](int key)
+        {
+            auto it = tree.LowerBound(key);
+            return it == tree.end() ? 0 : *it;
+        }, true, checksum);
+
+        double count = NsPerLookup(queries, [&](int key)
+        {
+            return static_cast<int>(tree.CountInRange(key, key + 1024));
+        }, true, checksum);
+
+        double insert = NsPerLookup(queries, [&](int key)
+        {
+            return *tree.insert(key);
+        }, true, checksum);
+
+        double set_find = NsPerLookup(queries, [&](int key)
+        {
+            auto it = reference.find(key);
+            return it == reference.end() ? 0 : *it;
+        }, true, checksum);
+
+        std::vector<Tree::const_iterator> found(queries.size());
+        std::vector<std::pair<int, int>>  ranges(queries.size());
+        std::vector<std::size_t>          counts(queries.size());
+
+        for (std::size_t i = 0; i < queries.size(); ++i)
+            ranges[i] = {queries[i], queries[i] + 1024};
+
+        auto start = Clock::now();
+        tree.FindBatch(queries, found);
+        double find_batch = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(queries.size());
+
+        start = Clock::now();
+        tree.CountInRangeBatch(ranges, counts);
+        double count_batch = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(queries.size());
+
+        for (std::size_t i = 0; i < queries.size(); ++i)
+            checksum += static_cast<unsigned>(*found[i]) + counts[i];
+
+        double mib = static_cast<double>(tree.size() * sizeof(Trees::RBT::RBTNode<int, std::greater<int>>)) / (1 << 20);
+
+        std::printf("%10zu %8.1f %12.1f %12.1f %12.1f %12.1f %14.1f %14.1f %12.1f %12.1f\n", tree.size(), mib,
+                    find_latency, find_throughput, lower_bound, count, insert, set_find, find_batch, count_batch);
+    }
+
+    std::printf("(checksum %zu)\n", checksum);
+}
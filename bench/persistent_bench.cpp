@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "RedBlackTree/parallel.hpp"
+#include "RedBlackTree/persistent_tree.hpp"
+#include "RedBlackTree/tree.hpp"
+
+// Ingest while long scans run: one writer inserts and erases random keys while scanners
+// walk scan_len keys at a time over a point-in-time view, from 0 scanners up to max_readers.
+// A Tree behind a std::shared_mutex (ConcurrentTree's lock, every scan under the shared lock)
+// against PersistentTree (every scan over a Snapshot, the writer never waits for it).
+// Reported: writer Mops/s, the longest single write, and scans per second.
+// usage: persistent_bench [keys] [writes] [scan_len] [max_readers]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Tree  = Trees::RBT::Tree<int, std::greater<int>>;
+using PTree = Trees::RBT::PersistentTree<int, std::greater<int>>;
+
+struct LockedTree
+{
+    Tree                      tree  = {};
+    mutable std::shared_mutex mutex = {};
+
+    void insert(int key) { std::unique_lock<std::shared_mutex> lock(mutex); tree.insert(key); }
+    void erase (int key) { std::unique_lock<std::shared_mutex> lock(mutex); tree.erase(key); }
+
+    std::size_t Scan(int lo, std::size_t len) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+
+        std::size_t sum = 0;
+        std::size_t n   = 0;
+
+        for (auto it = tree.LowerBound(lo); it != tree.end() && n < len; ++it, ++n)
+            sum += static_cast<std::size_t>(*it);
+
+        return sum;
+    }
+};
+
+struct SnapshotTree
+{
+    PTree tree = {};
+
+    template <typename InputIt>
+    SnapshotTree(InputIt first, InputIt last) : tree(first, last) {}
+
+    void insert(int key) { tree.insert(key); }
+    void erase (int key) { tree.erase(key); }
+
+    std::size_t Scan(int lo, std::size_t len) const
+    {
+        PTree::Snapshot_t snapshot = tree.Snapshot();
+
+        std::size_t sum = 0;
+        std::size_t n   = 0;
+
+        for (auto it = snapshot.LowerBound(lo); it != snapshot.end() && n < len; ++it, ++n)
+            sum += static_cast<std::size_t>(*it);
+
+        return sum;
+    }
+};
+
+constexpr int KEY_RANGE = 1 << 30;
+
+struct Result
+{
+    double write_mops;
+    double max_write_ms;
+    double scans_per_sec;
+};
+
+template <typename Shared>
+Result Run(Shared& shared, std::size_t writes, std::size_t scan_len, std::size_t readers, std::atomic<std::size_t>& checksum)
+{
+    std::atomic<bool>        done  = false;
+    std::atomic<std::size_t> scans = 0;
+
+    std::vector<std::thread> scanners;
+
+    for (std::size_t r = 0; r < readers; ++r)
+    {
+        scanners.emplace_back([&, r]
+        {
+            std::mt19937 rng(static_cast<unsigned>(r + 100));
+            std::size_t  local_sum = 0;
+
+            while (!done)
+            {
+                // start low enough that a scan rarely runs off the end
+                local_sum += shared.Scan(static_cast<int>(rng() % (KEY_RANGE / 2)), scan_len);
+                scans++;
+            }
+
+            checksum += local_sum;
+        });
+    }
+
+    std::mt19937 rng(1);
+    double       max_write_ms = 0;
+
+    auto start = Clock::now();
+
+    for (std::size_t op = 0; op < writes; ++op)
+    {
+        int key = static_cast<int>(rng() % KEY_RANGE);
+
+        auto write_start = Clock::now();
+
+        if (op % 2 == 0)
+            shared.insert(key);
+
+        else
+            shared.erase(key);
+
+        max_write_ms = std::max(max_write_ms, std::chrono::duration<double, std::milli>(Clock::now() - write_start).count());
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    done = true;
+
+    for (std::thread& scanner : scanners)
+        scanner.join();
+
+    return {static_cast<double>(writes) / seconds / 1e6, max_write_ms, static_cast<double>(scans) / seconds};
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t keys        = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t writes      = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200'000;
+    std::size_t scan_len    = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100'000;
+    std::size_t max_readers = argc > 4 ? std::strtoull(argv[4], nullptr, 10)
+                                       : std::max<std::size_t>(Trees::RBT::Parallel::HardwareThreads(), 2) - 1;
+
+    std::mt19937 rng(2);
+    std::vector<int> initial(keys);
+    for (int& key : initial)
+        key = static_cast<int>(rng() % KEY_RANGE);
+
+    // 0, then powers of two below max_readers, then max_readers itself
+    std::vector<std::size_t> reader_counts = {0};
+    for (std::size_t readers = 1; readers < max_readers; readers *= 2)
+        reader_counts.push_back(readers);
+    if (max_readers > 0)
+        reader_counts.push_back(max_readers);
+
+    std::atomic<std::size_t> checksum = 0;
+
+    std::printf("%zu keys, %zu writes, scans of %zu keys\n", keys, writes, scan_len);
+    std::printf("%8s | %-36s | %-36s\n", "", "shared_mutex + Tree", "PersistentTree snapshots");
+    std::printf("%8s | %10s %12s %12s | %10s %12s %12s\n", "scanners",
+                "write Mops", "max write ms", "scans/s", "write Mops", "max write ms", "scans/s");
+
+    for (std::size_t readers : reader_counts)
+    {
+        LockedTree locked;
+        locked.tree.BulkLoad(initial.begin(), initial.end());
+
+        SnapshotTree persistent(initial.begin(), initial.end());
+
+        Result locked_result     = Run(locked,     writes, scan_len, readers, checksum);
+        Result persistent_result = Run(persistent, writes, scan_len, readers, checksum);
+
+        std::printf("%8zu | %10.3f %12.3f %12.1f | %10.3f %12.3f %12.1f\n", readers,
+                    locked_result    .write_mops, locked_result    .max_write_ms, locked_result    .scans_per_sec,
+                    persistent_result.write_mops, persistent_result.max_write_ms, persistent_result.scans_per_sec);
+    }
+
+    std::printf("(checksum %zu)\n", checksum.load());
+}
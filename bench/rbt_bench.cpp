@@ -0,0 +1,299 @@
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "RedBlackTree/frozen_tree.hpp"
+#include "RedBlackTree/tree.hpp"
+
+// Regression benchmark: Tree, std::set and (for the read-only workloads) FrozenTree run the
+// same workloads at sizes 1K, 10K, ... up to max_keys. Results go to stdout as one JSON
+// document, progress to stderr, so runs can be stored and diffed: rbt_bench > run.json
+// Keys are even, so odd keys are guaranteed misses. bytes_per_key is the heap growth of a
+// randomly built container as reported by mallinfo2(), allocator slack included.
+// usage: rbt_bench [max_keys] [queries]
+
+namespace {
+
+using Clock      = std::chrono::steady_clock;
+using Tree       = Trees::RBT::Tree<int, std::greater<int>>;
+using FrozenTree = Trees::RBT::FrozenTree<int, std::greater<int>>;
+
+struct Result
+{
+    std::string container;
+    std::string workload;
+    std::size_t keys;
+    std::size_t ops;
+    double      ns_per_op;
+    double      bytes_per_key;
+};
+
+struct Workload
+{
+    std::vector<int> random_keys;       // insertion order of the random builds
+    std::vector<int> sorted_keys;       // the same keys sorted and unique
+    std::vector<int> hits;              // queries for present keys
+    std::vector<int> misses;            // odd keys, never present
+    int              range_len;         // covers about 64 keys on average
+};
+
+// the adapters give the workloads one interface over every container
+
+struct TreeAdapter
+{
+    static constexpr const char* NAME = "Tree";
+
+    Tree tree = {};
+
+    void        Insert(int key)             { tree.insert(key); }
+    void        Erase (int key)             { tree.erase(key); }
+    bool        Find  (int key) const       { return tree.find(key) != tree.end(); }
+    int         Lower (int key) const       { auto it = tree.LowerBound(key); return it == tree.end() ? 0 : *it; }
+    int         Upper (int key) const       { auto it = tree.UpperBound(key); return it == tree.end() ? 0 : *it; }
+    std::size_t Count (int lo, int hi) const { return tree.CountInRange(lo, hi); }
+    std::size_t Size  () const              { return tree.size(); }
+
+    template <typename Fn>
+    void        ForEach(Fn fn) const        { for (int key : tree) fn(key); }
+};
+
+struct SetAdapter
+{
+    static constexpr const char* NAME = "std::set";
+
+    std::set<int> set = {};
+
+    void        Insert(int key)             { set.insert(key); }
+    void        Erase (int key)             { set.erase(key); }
+    bool        Find  (int key) const       { return set.find(key) != set.end(); }
+    int         Lower (int key) const       { auto it = set.lower_bound(key); return it == set.end() ? 0 : *it; }
+    int         Upper (int key) const       { auto it = set.upper_bound(key); return it == set.end() ? 0 : *it; }
+    std::size_t Count (int lo, int hi) const { return static_cast<std::size_t>(std::distance(set.lower_bound(lo), set.upper_bound(hi))); }
+    std::size_t Size  () const              { return set.size(); }
+
+    template <typename Fn>
+    void        ForEach(Fn fn) const        { for (int key : set) fn(key); }
+};
+
+struct FrozenAdapter
+{
+    static constexpr const char* NAME = "FrozenTree";
+
+    FrozenTree frozen = {};
+
+    bool        Find  (int key) const       { return frozen.contains(key); }
+    int         Lower (int key) const       { auto it = frozen.LowerBound(key); return it == frozen.end() ? 0 : *it; }
+    int         Upper (int key) const       { auto it = frozen.UpperBound(key); return it == frozen.end() ? 0 : *it; }
+    std::size_t Count (int lo, int hi) const { return frozen.CountInRange(lo, hi); }
+    std::size_t Size  () const              { return frozen.size(); }
+
+    template <typename Fn>
+    void        ForEach(Fn fn) const        { for (int key : frozen) fn(key); }
+};
+
+std::size_t checksum = 0;
+
+std::size_t HeapBytes()
+{
+    struct mallinfo2 info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+}
+
+template <typename Fn>
+double NsPerOp(std::size_t ops, Fn fn)
+{
+    auto start = Clock::now();
+
+    fn();
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    return ns / static_cast<double>(ops == 0 ? 1 : ops);
+}
+
+Workload MakeWorkload(std::size_t key_count, std::size_t query_count)
+{
+    std::mt19937 rng(static_cast<unsigned>(key_count));
+    Workload     work = {};
+
+    // even keys below 2^30, so a key plus range_len never overflows
+    unsigned key_space = 1u << 29;
+
+    work.random_keys.resize(key_count);
+    for (int& key : work.random_keys)
+        key = static_cast<int>(rng() % key_space) * 2;
+
+    work.sorted_keys = work.random_keys;
+    std::sort(work.sorted_keys.begin(), work.sorted_keys.end());
+    work.sorted_keys.erase(std::unique(work.sorted_keys.begin(), work.sorted_keys.end()), work.sorted_keys.end());
+
+    work.hits  .resize(query_count);
+    work.misses.resize(query_count);
+
+    for (std::size_t i = 0; i < query_count; ++i)
+    {
+        work.hits  [i] = work.random_keys[rng() % key_count];
+        work.misses[i] = work.hits[i] + 1;
+    }
+
+    work.range_len = static_cast<int>(std::min<std::size_t>(2ull * key_space / key_count * 64, 1u << 30));
+
+    return work;
+}
+
+// lookups, range counts and the full scan: every container runs them
+template <typename Adapter>
+void RunReads(const Adapter& adapter, const Workload& work, double bytes_per_key, std::vector<Result>& results)
+{
+    std::size_t keys = adapter.Size();
+    std::size_t ops  = work.hits.size();
+
+    auto add = [&](const char* workload, std::size_t count, double ns)
+    {
+        results.push_back({Adapter::NAME, workload, keys, count, ns, bytes_per_key});
+    };
+
+    add("find_hit", ops, NsPerOp(ops, [&] { for (int key : work.hits) checksum += adapter.Find(key); }));
+    add("find_miss", ops, NsPerOp(ops, [&] { for (int key : work.misses) checksum += adapter.Find(key); }));
+    add("lower_bound", ops, NsPerOp(ops, [&] { for (int key : work.misses) checksum += static_cast<unsigned>(adapter.Lower(key)); }));
+    add("upper_bound", ops, NsPerOp(ops, [&] { for (int key : work.hits) checksum += static_cast<unsigned>(adapter.Upper(key)); }));
+
+    add("range_count", ops, NsPerOp(ops, [&]
+    {
+        for (int key : work.hits)
+            checksum += adapter.Count(key, key + work.range_len);
+    }));
+
+    add("iterate", keys, NsPerOp(keys, [&] { adapter.ForEach([](int key) { checksum += static_cast<unsigned>(key); }); }));
+}
+
+template <typename Adapter>
+void RunContainer(const Workload& work, std::vector<Result>& results)
+{
+    std::size_t key_count = work.random_keys.size();
+    std::size_t ops       = work.hits.size();
+
+    constexpr bool FROZEN = std::is_same_v<Adapter, FrozenAdapter>;
+
+    // the snapshot is taken from a tree built outside the timing and the heap accounting
+    Tree source = {};
+    if constexpr (FROZEN)
+        source.BulkLoad(work.random_keys.begin(), work.random_keys.end());
+
+    std::size_t heap_before = HeapBytes();
+    Adapter     adapter     = {};
+
+    double build_ns = NsPerOp(key_count, [&]
+    {
+        if constexpr (FROZEN)
+            adapter.frozen = FrozenTree(source);
+        else
+            for (int key : work.random_keys)
+                adapter.Insert(key);
+    });
+
+    double bytes_per_key = static_cast<double>(HeapBytes() - heap_before) / static_cast<double>(adapter.Size());
+
+    auto add = [&](const char* workload, std::size_t count, double ns)
+    {
+        results.push_back({Adapter::NAME, workload, adapter.Size(), count, ns, bytes_per_key});
+    };
+
+    if constexpr (FROZEN)
+    {
+        add("freeze", key_count, build_ns);
+    }
+    else
+    {
+        add("insert_random", key_count, build_ns);
+
+        for (bool reverse : {false, true})
+        {
+            Adapter ordered = {};
+
+            double ns = NsPerOp(work.sorted_keys.size(), [&]
+            {
+                if (reverse)
+                    for (auto it = work.sorted_keys.rbegin(); it != work.sorted_keys.rend(); ++it)
+                        ordered.Insert(*it);
+                else
+                    for (int key : work.sorted_keys)
+                        ordered.Insert(key);
+            });
+
+            add(reverse ? "insert_reverse" : "insert_sorted", work.sorted_keys.size(), ns);
+        }
+    }
+
+    RunReads(adapter, work, bytes_per_key, results);
+
+    if constexpr (!FROZEN)
+    {
+        // one op is an erase of a present key and its reinsertion, so the size stays put
+        add("erase_churn", ops, NsPerOp(ops, [&]
+        {
+            for (int key : work.hits)
+            {
+                adapter.Erase (key);
+                adapter.Insert(key);
+            }
+        }));
+    }
+}
+
+void PrintJson(const std::vector<Result>& results, std::size_t max_keys, std::size_t query_count)
+{
+    std::printf("{\n");
+    std::printf("  \"benchmark\": \"rbt_bench\",\n");
+    std::printf("  \"context\": {\"max_keys\": %zu, \"queries\": %zu, \"key_bytes\": %zu, \"rbt_prefetch\": %d, \"rbt_threaded\": %d},\n",
+                max_keys, query_count, sizeof(int), RBT_PREFETCH, RBT_THREADED);
+    std::printf("  \"results\": [\n");
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result = results[i];
+
+        std::printf("    {\"container\": \"%s\", \"workload\": \"%s\", \"keys\": %zu, \"ops\": %zu, "
+                    "\"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, \"bytes_per_key\": %.2f}%s\n",
+                    result.container.c_str(), result.workload.c_str(), result.keys, result.ops,
+                    result.ns_per_op, 1e9 / result.ns_per_op, result.bytes_per_key, i + 1 < results.size() ? "," : "");
+    }
+
+    std::printf("  ],\n");
+    std::printf("  \"checksum\": %zu\n", checksum);
+    std::printf("}\n");
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t max_keys    = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t query_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+
+    std::vector<Result> results;
+
+    for (std::size_t key_count = 1000; key_count <= max_keys; key_count *= 10)
+    {
+        Workload work = MakeWorkload(key_count, query_count);
+
+        std::fprintf(stderr, "rbt_bench: %zu keys\n", key_count);
+
+        RunContainer<TreeAdapter>  (work, results);
+        RunContainer<SetAdapter>   (work, results);
+        RunContainer<FrozenAdapter>(work, results);
+    }
+
+    PrintJson(results, max_keys, query_count);
+}
@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "RedBlackTree/tree.hpp"
+
+// Full-scan and range-scan throughput: iterator loops against Tree::ForEachInRange.
+// The same source is built twice: scan_bench with RBT_THREADED=0 (iterators climb
+// fathers) and scan_bench_threaded with RBT_THREADED=1 (iterators follow neighbour links).
+// Keys are inserted in random order, so neighbours in the tree are not neighbours in memory.
+// usage: scan_bench [keys] [ranges] [range_len]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Tree  = Trees::RBT::Tree<int, std::greater<int>>;
+
+struct Range
+{
+    int lo;
+    int hi;
+};
+
+template <typename Scan>
+double NsPerKey(Scan scan, std::size_t& checksum)
+{
+    std::size_t visited = 0;
+
+    auto start = Clock::now();
+
+    checksum += scan(visited);
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    return ns / static_cast<double>(visited == 0 ? 1 : visited);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t key_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t ranges    = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100'000;
+    int         range_len = argc > 3 ? std::atoi(argv[3]) : 1 << 12;
+
+    std::mt19937 rng(1);
+    Tree tree;
+
+    int key_range = static_cast<int>(key_count) * 4;
+
+    for (std::size_t i = 0; i < key_count; ++i)
+        tree.insert(static_cast<int>(rng() % static_cast<unsigned>(key_range)));
+
+    std::vector<Range> queries(ranges);
+    for (Range& range : queries)
+    {
+        range.lo = static_cast<int>(rng() % static_cast<unsigned>(key_range));
+        range.hi = range.lo + range_len;
+    }
+
+    std::size_t checksum = 0;
+
+    double full_iterator_ns = NsPerKey([&](std::size_t& visited)
+    {
+        std::size_t sum = 0;
+
+        for (int key : tree)
+        {
+            sum += static_cast<unsigned>(key);
+            ++visited;
+        }
+
+        return sum;
+    }, checksum);
+
+    double full_foreach_ns = NsPerKey([&](std::size_t& visited)
+    {
+        std::size_t sum = 0;
+
+        tree.ForEachInRange(tree.front(), tree.back(), [&](int key)
+        {
+            sum += static_cast<unsigned>(key);
+            ++visited;
+        });
+
+        return sum;
+    }, checksum);
+
+    double range_iterator_ns = NsPerKey([&](std::size_t& visited)
+    {
+        std::size_t sum = 0;
+
+        for (const Range& range : queries)
+        {
+            for (auto it = tree.LowerBound(range.lo), end = tree.UpperBound(range.hi); it != end; ++it)
+            {
+                sum += static_cast<unsigned>(*it);
+                ++visited;
+            }
+        }
+
+        return sum;
+    }, checksum);
+
+    double range_foreach_ns = NsPerKey([&](std::size_t& visited)
+    {
+        std::size_t sum = 0;
+
+        for (const Range& range : queries)
+        {
+            tree.ForEachInRange(range.lo, range.hi, [&](int key)
+            {
+                sum += static_cast<unsigned>(key);
+                ++visited;
+            });
+        }
+
+        return sum;
+    }, checksum);
+
+    double distance_ns = NsPerKey([&](std::size_t& visited)
+    {
+        std::size_t count = 0;
+
+        for (const Range& range : queries)
+            count += static_cast<std::size_t>(std::distance(tree.LowerBound(range.lo), tree.UpperBound(range.hi)));
+
+        visited = count;
+
+        return count;
+    }, checksum);
+
+    std::printf("RBT_THREADED=%d  keys %zu  node %zu bytes\n", RBT_THREADED, tree.size(), sizeof(Trees::RBT::RBTNode<int, std::greater<int>>));
+    std::printf("full scan:   iterator %6.2f ns/key  ForEachInRange %6.2f ns/key\n", full_iterator_ns, full_foreach_ns);
+    std::printf("range scan:  iterator %6.2f ns/key  ForEachInRange %6.2f ns/key  std::distance %6.2f ns/key  (%zu ranges of %d)\n",
+                range_iterator_ns, range_foreach_ns, distance_ns, ranges, range_len);
+    std::printf("(checksum %zu)\n", checksum);
+}
@@ -0,0 +1,122 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "RedBlackTree/tree.hpp"
+
+// Hot-path counters per operation and the shape of the resulting trees. The same source is
+// built twice: stats_bench with RBT_STATS=0 (counters compiled out, the times are the
+// reference) and stats_bench_counted with RBT_STATS=1 (counters on, times show their cost).
+// usage: stats_bench [keys] [queries]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Tree  = Trees::RBT::Tree<int, std::greater<int>>;
+
+void PrintPhase(const char* name, std::size_t ops, double ns, const Trees::RBT::TreeStats& stats)
+{
+    double n = static_cast<double>(ops);
+
+    std::printf("%-14s %9.1f ns/op", name, ns / n);
+
+#if RBT_STATS
+    auto per = [](std::uint64_t count, std::uint64_t of) { return of == 0 ? 0.0 : static_cast<double>(count) / static_cast<double>(of); };
+
+    std::printf("  cmp/op %6.2f  rot/op %5.3f  fixup iter: ins %5.3f del %5.3f  path %6.2f  climbs/op %5.3f",
+                per(stats.comparisons, ops), per(stats.left_rotations + stats.right_rotations, ops),
+                per(stats.insert_fixup_iterations, stats.insert_fixups), per(stats.delete_fixup_iterations, stats.delete_fixups),
+                per(stats.descent_nodes, stats.descents), per(stats.climbs, ops));
+#else
+    (void)stats;
+#endif
+
+    std::printf("\n");
+}
+
+template <typename Fn>
+void Phase(Tree& tree, const char* name, std::size_t ops, Fn fn)
+{
+    tree.ResetStats();
+
+    auto start = Clock::now();
+
+    fn();
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    PrintPhase(name, ops, ns, tree.Stats());
+}
+
+void PrintShape(const char* name, const Tree& tree)
+{
+    std::vector<std::size_t> histogram = tree.DepthHistogram();
+
+    double      bound      = 2 * std::log2(static_cast<double>(tree.size()) + 1);
+    std::size_t depth_sum  = 0;
+
+    for (std::size_t depth = 0; depth < histogram.size(); ++depth)
+        depth_sum += depth * histogram[depth];
+
+    std::printf("%-14s %zu keys  height %zu (bound 2 log2(n+1) = %.1f, log2(n+1) = %.1f)  black height %u  mean depth %.2f\n",
+                name, tree.size(), tree.Height(), bound, bound / 2, tree.BlackHeight(),
+                static_cast<double>(depth_sum) / static_cast<double>(tree.size() == 0 ? 1 : tree.size()));
+
+    std::printf("%-14s depth histogram:", "");
+    for (std::size_t count : histogram)
+        std::printf(" %zu", count);
+    std::printf("\n");
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t key_count   = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t query_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+
+    std::mt19937 rng(1);
+
+    std::vector<int> keys(key_count);
+    for (int& key : keys)
+        key = static_cast<int>(rng() >> 1);
+
+    std::vector<int> queries(query_count);
+    for (int& query : queries)
+        query = keys[rng() % key_count];
+
+    std::size_t checksum = 0;
+
+    std::printf("RBT_STATS=%d\n", RBT_STATS);
+
+    Tree random_tree;
+    Tree sorted_tree;
+
+    Phase(random_tree, "insert random", key_count, [&] { for (int key : keys) random_tree.insert(key); });
+    Phase(sorted_tree, "insert sorted", key_count, [&] { for (std::size_t i = 0; i < key_count; ++i) sorted_tree.insert(static_cast<int>(i)); });
+
+    Phase(random_tree, "find", query_count, [&]
+    {
+        for (int query : queries)
+            checksum += random_tree.find(query) != random_tree.end();
+    });
+
+    Phase(random_tree, "iterate", random_tree.size(), [&] { for (int key : random_tree) checksum += static_cast<unsigned>(key); });
+
+    PrintShape("random", random_tree);
+    PrintShape("sorted", sorted_tree);
+
+    Phase(random_tree, "erase half", key_count / 2, [&] { for (std::size_t i = 0; i < key_count / 2; ++i) random_tree.erase(keys[i]); });
+
+    PrintShape("after erase", random_tree);
+
+#if RBT_STATS
+    random_tree.DumpStats();
+#endif
+
+    std::printf("(checksum %zu)\n", checksum);
+}
@@ -0,0 +1,93 @@
+// Measures what tree tracing costs on a lookup-heavy run. The same source is built
+// twice: trace_bench with RBT_TRACE_LEVEL=0 and trace_bench_traced with RBT_TRACE_LEVEL=2.
+// usage: trace_bench [keys] [queries]
+
+#include "RLogSU/error_handler.hpp"
+#include "RLogSU/logger.hpp"
+
+#undef RBT_TRACE_LEVEL
+#ifdef RBT_BENCH_TRACED
+#   define RBT_TRACE_LEVEL 2
+#else
+#   define RBT_TRACE_LEVEL 0
+
+// With tracing off the tree headers must not reach RLogSU at all:
+// a logger call left on some path breaks this build instead of slowing it down.
+#   undef  RLSU_INFO
+#   undef  RLSU_WARNING
+#   undef  RLSU_ASSERT
+#   undef  ERROR_HANDLE
+#   define RLSU_INFO(...)    static_assert(false, "RLSU_INFO reached with RBT_TRACE_LEVEL=0")
+#   define RLSU_WARNING(...) static_assert(false, "RLSU_WARNING reached with RBT_TRACE_LEVEL=0")
+#   define RLSU_ASSERT(...)  static_assert(false, "RLSU_ASSERT reached with RBT_TRACE_LEVEL=0")
+#   define ERROR_HANDLE(...) static_assert(false, "ERROR_HANDLE reached with RBT_TRACE_LEVEL=0")
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "RedBlackTree/tree.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double NsPerOp(Clock::time_point start, std::size_t ops)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(ops);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t key_count   = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t query_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : key_count;
+
+    std::mt19937 rng(1);
+    Trees::RBT::Tree<int, std::greater<int>> tree;
+
+    auto start = Clock::now();
+
+    for (std::size_t i = 0; i < key_count; ++i)
+        tree.insert(static_cast<int>(rng()));
+
+    double insert_ns = NsPerOp(start, key_count);
+
+    std::vector<int> bounds(query_count * 2);
+    for (int& bound : bounds)
+        bound = static_cast<int>(rng());
+
+    std::size_t checksum = 0;
+
+    start = Clock::now();
+
+    for (std::size_t i = 0; i < query_count; ++i)
+    {
+        auto lower = tree.LowerBound(bounds[2 * i]);
+        auto upper = tree.UpperBound(bounds[2 * i + 1]);
+
+        checksum += (lower != tree.end()) + (upper != tree.end());
+    }
+
+    double bounds_ns = NsPerOp(start, query_count);
+
+    start = Clock::now();
+
+    for (std::size_t i = 0; i < query_count; ++i)
+    {
+        int lo = std::min(bounds[2 * i], bounds[2 * i + 1]);
+        int hi = std::max(bounds[2 * i], bounds[2 * i + 1]);
+
+        checksum += tree.CountInRange(lo, hi);
+    }
+
+    double count_ns = NsPerOp(start, query_count);
+
+    std::printf("RBT_TRACE_LEVEL=%d  keys %zu  insert %.1f ns/op  LowerBound+UpperBound %.1f ns/op  CountInRange %.1f ns/op  (checksum %zu)\n",
+                RBT_TRACE_LEVEL, key_count, insert_ns, bounds_ns, count_ns, checksum);
+}
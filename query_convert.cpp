@@ -0,0 +1,37 @@
+#include <unistd.h>
+
+#include "RLogSU/logger.hpp"
+#include "query_io.hpp"
+
+// Converts range_query text commands from stdin into the binary command format on stdout.
+// usage: query_convert < task.dat > task.bin
+
+int main()
+{
+    QueryIO::CommandReader input(STDIN_FILENO);
+    QueryIO::OutputBuffer  output(STDOUT_FILENO);
+    QueryIO::Command       command = {};
+
+    output.Append(QueryIO::MAGIC, QueryIO::MAGIC_SIZE);
+
+    while (input.Next(command))
+    {
+        if (command.type == QueryIO::CommandType::KEY)
+        {
+            output.Append("k", 1);
+            output.PutKey(command.first);
+        }
+
+        else if (command.type == QueryIO::CommandType::QUERY)
+        {
+            output.Append("q", 1);
+            output.PutKey(command.first);
+            output.PutKey(command.second);
+        }
+
+        else
+        {
+            RLSU_WARNING("invalid request: '{}'", command.token);
+        }
+    }
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Streaming front-end for range_query: commands come either as text ("k 10 q 8 31")
+// or in the compact binary format produced by query_convert, answers leave in large writes.
+//
+// Binary format: the 8-byte MAGIC, then records of an opcode byte ('k' or 'q')
+// followed by one or two little-endian int32 keys.
+
+namespace QueryIO {
+
+inline constexpr char        MAGIC[]    = {'R', 'B', 'T', 'Q', 'B', 'I', 'N', '1'};
+inline constexpr std::size_t MAGIC_SIZE = sizeof(MAGIC);
+
+enum class CommandType { KEY, QUERY, INVALID };
+
+struct Command
+{
+    CommandType type;
+    int         first;
+    int         second;
+    std::string token;      // the unknown command word for INVALID
+};
+
+
+// Reads a regular file through mmap and anything else through large read() calls.
+class CommandReader
+{
+public:
+    explicit CommandReader(int fd)
+        : fd_(fd)
+    {
+        struct stat info = {};
+
+        if (fstat(fd_, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            void* mapped = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+
+            if (mapped != MAP_FAILED)
+            {
+                madvise(mapped, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+
+                mapped_      = static_cast<const char*>(mapped);
+                mapped_size_ = static_cast<std::size_t>(info.st_size);
+                pos_         = mapped_;
+                end_         = pos_ + mapped_size_;
+            }
+        }
+
+        if (!IsMapped_())
+            buffer_.resize(BUFFER_SIZE);
+
+        binary_ = Ensure_(MAGIC_SIZE) && std::memcmp(pos_, MAGIC, MAGIC_SIZE) == 0;
+
+        if (binary_)
+            pos_ += MAGIC_SIZE;
+    }
+
+    CommandReader(const CommandReader&)            = delete;
+    CommandReader& operator=(const CommandReader&) = delete;
+
+    ~CommandReader()
+    {
+        if (IsMapped_())
+            munmap(const_cast<char*>(mapped_), mapped_size_);
+    }
+
+    bool IsBinary() const { return binary_; }
+
+    // false at the end of input or on a malformed number, like std::cin going bad
+    bool Next(Command& command)
+    {
+        return binary_ ? NextBinary_(command) : NextText_(command);
+    }
+
+private:
+    static constexpr std::size_t BUFFER_SIZE = 1 << 20;
+
+    int               fd_;
+    std::vector<char> buffer_      = {};
+    const char*       mapped_      = nullptr;
+    std::size_t       mapped_size_ = 0;
+    const char*       pos_         = nullptr;
+    const char*       end_         = nullptr;
+    bool              eof_         = false;
+    bool              binary_      = false;
+
+    bool IsMapped_() const { return mapped_size_ != 0; }
+
+    static bool IsSpace_(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    // makes at least `count` unread bytes contiguous, false if the input ends before that
+    bool Ensure_(std::size_t count)
+    {
+        while (static_cast<std::size_t>(end_ - pos_) < count)
+        {
+            if (IsMapped_() || eof_)
+                return false;
+
+            std::size_t left = static_cast<std::size_t>(end_ - pos_);
+
+            if (left != 0)
+                std::memmove(buffer_.data(), pos_, left);
+
+            ssize_t got = 0;
+
+            do
+                got = read(fd_, buffer_.data() + left, buffer_.size() - left);
+            while (got < 0 && errno == EINTR);
+
+            if (got <= 0)
+                eof_ = true;
+
+            pos_ = buffer_.data();
+            end_ = pos_ + left + (got > 0 ? got : 0);
+        }
+
+        return true;
+    }
+
+    bool SkipSpaces_()
+    {
+        while (Ensure_(1))
+        {
+            if (!IsSpace_(*pos_))
+                return true;
+
+            ++pos_;
+        }
+
+        return false;
+    }
+
+    bool ReadInt_(int& value)
+    {
+        if (!SkipSpaces_())
+            return false;
+
+        bool negative = (*pos_ == '-');
+
+        if (*pos_ == '-' || *pos_ == '+')
+            ++pos_;
+
+        if (!Ensure_(1) || *pos_ < '0' || *pos_ > '9')
+            return false;
+
+        constexpr std::int64_t LIMIT = static_cast<std::int64_t>(std::numeric_limits<int>::max()) + 1;
+        std::int64_t magnitude = 0;
+
+        do
+        {
+            magnitude = magnitude * 10 + (*pos_++ - '0');
+
+            if (magnitude > LIMIT)
+                return false;
+        }
+        while (Ensure_(1) && *pos_ >= '0' && *pos_ <= '9');
+
+        if (!negative && magnitude == LIMIT)
+            return false;
+
+        value = static_cast<int>(negative ? -magnitude : magnitude);
+
+        return true;
+    }
+
+    bool NextText_(Command& command)
+    {
+        if (!SkipSpaces_())
+            return false;
+
+        char word = *pos_++;
+
+        if ((word == 'k' || word == 'q') && (!Ensure_(1) || IsSpace_(*pos_)))
+        {
+            command.type = (word == 'k') ? CommandType::KEY : CommandType::QUERY;
+
+            if (!ReadInt_(command.first))
+                return false;
+
+            return word == 'k' || ReadInt_(command.second);
+        }
+
+        command.type  = CommandType::INVALID;
+        command.token = word;
+
+        while (Ensure_(1) && !IsSpace_(*pos_))
+            command.token += *pos_++;
+
+        return true;
+    }
+
+    bool NextBinary_(Command& command)
+    {
+        if (!Ensure_(1))
+            return false;
+
+        char opcode = *pos_;
+
+        if (opcode != 'k' && opcode != 'q')
+        {
+            command.type  = CommandType::INVALID;
+            command.token = std::string(1, opcode);
+
+            // a binary stream cannot be resynchronized after a bad opcode
+            pos_ = end_;
+            eof_ = true;
+
+            return true;
+        }
+
+        std::size_t keys = (opcode == 'k') ? 1 : 2;
+
+        if (!Ensure_(1 + keys * sizeof(std::int32_t)))
+            return false;
+
+        command.type   = (opcode == 'k') ? CommandType::KEY : CommandType::QUERY;
+        command.first  = LoadKey_(pos_ + 1);
+        command.second = (keys == 2) ? LoadKey_(pos_ + 1 + sizeof(std::int32_t)) : 0;
+
+        pos_ += 1 + keys * sizeof(std::int32_t);
+
+        return true;
+    }
+
+    static int LoadKey_(const char* bytes)
+    {
+        std::uint32_t value = 0;
+
+        for (std::size_t i = 0; i < sizeof(value); ++i)
+            value |= static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+
+        return static_cast<int>(value);
+    }
+};
+
+
+// Collects output in one buffer and hands it to write() only when it fills up.
+class OutputBuffer
+{
+public:
+    explicit OutputBuffer(int fd)
+        : fd_(fd)
+    {
+        buffer_.reserve(BUFFER_SIZE);
+    }
+
+    OutputBuffer(const OutputBuffer&)            = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    ~OutputBuffer() { Flush(); }
+
+    // writes `value` followed by a space, the way `std::cout << value << " "` does
+    void PutCount(std::size_t value)
+    {
+        char digits[24];
+        char* digit = digits + sizeof(digits);
+
+        do
+        {
+            *--digit = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+        while (value != 0);
+
+        Append(digit, static_cast<std::size_t>(digits + sizeof(digits) - digit));
+        Append(" ", 1);
+    }
+
+    void PutKey(int key)
+    {
+        char bytes[sizeof(std::int32_t)];
+        std::uint32_t value = static_cast<std::uint32_t>(key);
+
+        for (std::size_t i = 0; i < sizeof(bytes); ++i)
+            bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+
+        Append(bytes, sizeof(bytes));
+    }
+
+    void Append(const char* data, std::size_t count)
+    {
+        if (buffer_.size() + count > BUFFER_SIZE)
+            Flush();
+
+        buffer_.insert(buffer_.end(), data, data + count);
+    }
+
+    void Flush()
+    {
+        const char* data = buffer_.data();
+        std::size_t left = buffer_.size();
+
+        while (left != 0)
+        {
+            ssize_t written = write(fd_, data, left);
+
+            if (written < 0 && errno == EINTR)
+                continue;
+
+            if (written <= 0)
+                break;
+
+            data += written;
+            left -= static_cast<std::size_t>(written);
+        }
+
+        buffer_.clear();
+    }
+
+private:
+    static constexpr std::size_t BUFFER_SIZE = 1 << 20;
+
+    int               fd_;
+    std::vector<char> buffer_ = {};
+};
+
+}
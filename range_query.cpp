@@ -1,58 +1,133 @@
-#include <iostream>
-#include <iterator>
+#include <algorithm>
+#include <span>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 #include "RLogSU/logger.hpp"
+#include "RedBlackTree/frozen_tree.hpp"
 #include "RedBlackTree/tree.hpp"
+#include "query_io.hpp"
 
 // #include "RedBlackTree/red-black_tree.hpp"
 
+namespace {
+
+using Tree       = Trees::RBT::Tree<int, std::greater<int>>;
+using FrozenTree = Trees::RBT::FrozenTree<int, std::greater<int>>;
+
+// queries of one epoch are kept in memory until answered, long runs are answered in blocks of this size
+constexpr std::size_t MAX_EPOCH_QUERIES = 1 << 18;
+
+// an epoch of at least size / FREEZE_RATIO queries pays for rebuilding the frozen snapshot
+constexpr std::size_t FREEZE_RATIO = 16;
+
+// answers a run of queries with no inserts in between: the tree is only read, so the run is split
+// between the pool threads, each answers its part with batched lookups, and the answers are
+// printed in input order afterwards; queries come with lo <= hi
+template <typename AnyTree>
+void AnswerEpoch(const AnyTree& tree, const std::vector<std::pair<int, int>>& queries, std::vector<std::size_t>& answers,
+                 Trees::RBT::Parallel::ThreadPool& pool, QueryIO::OutputBuffer& output)
+{
+    answers.resize(queries.size());
+
+    pool.ParallelFor(queries.size(), [&](std::size_t begin, std::size_t end)
+    {
+        tree.CountInRangeBatch(std::span(queries).subspan(begin, end - begin),
+                               std::span(answers).subspan(begin, end - begin));
+    });
+
+    for (std::size_t count : answers)
+        output.PutCount(count);
+}
+
+}
+
 int main()
 {
-    Trees::RBT::Tree<int, std::greater<int>> tree;
+    Tree tree;
+
+    // stdin is either text commands or the binary format written by query_convert
+    QueryIO::CommandReader input(STDIN_FILENO);
+    QueryIO::OutputBuffer  output(STDOUT_FILENO);
+    QueryIO::Command       command = {};
+
+    // keys before the first query are loaded in one linear pass
+    std::vector<int> startup_keys;
+    bool             queried = false;
+
+    Trees::RBT::Parallel::ThreadPool  pool;
+    std::vector<std::pair<int, int>>  epoch_queries;
+    std::vector<std::size_t>          epoch_answers;
 
-    std::string command;
+    // read-only copy of tree, valid until the next insert that adds a key
+    FrozenTree frozen;
+    bool       frozen_valid = false;
 
-    while (std::cin >> command)
+    auto flush_epoch = [&]
     {
-        if (command == "k")
+        if (!frozen_valid && epoch_queries.size() * FREEZE_RATIO >= tree.size())
         {
-            int key;
-            std::cin >> key;
+            frozen       = FrozenTree(tree);
+            frozen_valid = true;
+        }
+
+        if (frozen_valid)
+            AnswerEpoch(frozen, epoch_queries, epoch_answers, pool, output);
+        else
+            AnswerEpoch(tree,   epoch_queries, epoch_answers, pool, output);
+
+        epoch_queries.clear();
+    };
+
+    while (input.Next(command))
+    {
+        if (command.type == QueryIO::CommandType::KEY)
+        {
+            int key = command.first;
+
+            if (!queried)
+            {
+                startup_keys.push_back(key);
+                continue;
+            }
+
+            flush_epoch();
+
+            std::size_t old_size = tree.size();
+
             tree.insert(key);
+
+            frozen_valid = frozen_valid && tree.size() == old_size;
                 RLSU_DUMP(tree.Dump());
 
         }
         
-        else if (command == "q")
+        else if (command.type == QueryIO::CommandType::QUERY)
         {
-            int a, b;
-            std::cin >> a >> b;
-            
-            auto start = tree.end();
-            auto end   = tree.end();
-
-            if (a <= b)
+            if (!queried)
             {
-                start = tree.LowerBound(a);
-                end   = tree.UpperBound(b);
+                tree.BulkLoad(startup_keys.begin(), startup_keys.end());
+                startup_keys = {};
+                queried = true;
             }
 
-            else
-            {
-                start = tree.LowerBound(b);
-                end   = tree.UpperBound(a);
-            }
+            auto [lo, hi] = std::minmax(command.first, command.second);
+
+            epoch_queries.emplace_back(lo, hi);
 
-            // RLSU_INFO("a = {}, b = {}; start = {}, end = {}", a, b, *start, *end);
-            
-            std::ptrdiff_t dist = std::distance(start, end);
-            std::cout << dist << " ";
+            if (epoch_queries.size() == MAX_EPOCH_QUERIES)
+                flush_epoch();
         }
 
         else
         {
-            RLSU_WARNING("invalid request: '{}'", command);
+            RLSU_WARNING("invalid request: '{}'", command.token);
         }
     }
 
+    flush_epoch();
+
+    tree.BulkLoad(startup_keys.begin(), startup_keys.end());
+
     RLSU_DUMP(tree.Dump());
-}
\ No newline at end of file
+}
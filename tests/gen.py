@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Seeded k/q workload generator for range_query with reference answers.
+
+Writes DIR/tasks/<name>.dat and DIR/answers/<name>.dat in the format of tests/tasks, so
+the result runs as is: run.py --task-dir DIR/tasks --key-dir DIR/answers [--time].
+The answers come from an offline Fenwick tree over the compressed keys, which shares
+nothing with the tree under test. The same arguments always give the same files.
+"""
+import argparse, bisect, itertools, random, sys
+from pathlib import Path
+
+INT_MIN, INT_MAX = -2**31, 2**31 - 1
+DISTS = ("uniform", "zipf", "sequential", "clustered")
+
+def clamp(v:int)->int: return max(INT_MIN, min(INT_MAX, v))
+
+def key_source(dist:str, rng:random.Random, key_range:int, zipf_s:float):
+    """Endless generator of keys in [-key_range, key_range] with the given distribution."""
+    span = 2 * key_range + 1
+    if dist == "uniform":
+        while True: yield rng.randint(-key_range, key_range)
+    elif dist == "zipf":
+        # ranks up to 2^20 with P(r) ~ 1/r^s, spread over the range by a multiplicative hash
+        ranks = min(span, 1 << 20)
+        cdf = list(itertools.accumulate(1.0 / (r ** zipf_s) for r in range(1, ranks + 1)))
+        while True:
+            r = bisect.bisect_left(cdf, rng.random() * cdf[-1])
+            yield (r * 2654435761) % span - key_range
+    elif dist == "sequential":
+        key = -key_range
+        while True:
+            yield key
+            key += rng.randint(1, 4)
+            if key > key_range: key = -key_range + rng.randint(0, 3)
+    elif dist == "clustered":
+        centers = [rng.randint(-key_range, key_range) for _ in range(64)]
+        spread = max(1, key_range // 4096)
+        while True: yield clamp(int(rng.gauss(rng.choice(centers), spread)))
+    else:
+        raise ValueError(dist)
+
+def generate(dist:str, args)->list:
+    """List of ("k", key) and ("q", lo, hi) commands."""
+    rng = random.Random(f"{args.seed}:{dist}")
+    keys = key_source(dist, rng, args.key_range, args.zipf_s)
+    total_keys = round(args.ops * (1 - args.query_ratio))
+    preload = round(total_keys * args.preload)
+    ops = [("k", next(keys)) for _ in range(preload)]
+    # the rest interleaves keys and queries in random order
+    rest = [True] * (total_keys - preload) + [False] * (args.ops - total_keys)
+    rng.shuffle(rest)
+    for is_key in rest:
+        if is_key:
+            ops.append(("k", next(keys)))
+        else:
+            lo = next(keys)
+            ops.append(("q", lo, clamp(lo + int(rng.expovariate(1.0 / args.width)))))
+    return ops
+
+def answer(ops:list)->list:
+    """Counts of distinct keys in [lo, hi] for every query, by a Fenwick tree over compressed keys."""
+    coords = sorted({op[1] for op in ops if op[0] == "k"})
+    index = {key: i + 1 for i, key in enumerate(coords)}
+    fenwick = [0] * (len(coords) + 1)
+    present = set()
+    def prefix(i:int)->int:
+        s = 0
+        while i > 0: s += fenwick[i]; i -= i & -i
+        return s
+    counts = []
+    for op in ops:
+        if op[0] == "k":
+            if op[1] in present: continue
+            present.add(op[1])
+            i = index[op[1]]
+            while i < len(fenwick): fenwick[i] += 1; i += i & -i
+        else:
+            lo, hi = min(op[1], op[2]), max(op[1], op[2])
+            counts.append(prefix(bisect.bisect_right(coords, hi)) - prefix(bisect.bisect_left(coords, lo)))
+    return counts
+
+def write(path:Path, chunks):
+    path.parent.mkdir(parents=True, exist_ok=True)
+    with path.open("w") as f:
+        for chunk in chunks: f.write(chunk)
+
+def main():
+    script_dir = Path(__file__).resolve().parent
+    ap = argparse.ArgumentParser(description="Generate seeded range_query workloads with reference answers.")
+    ap.add_argument("-o","--out", default=str(script_dir/"generated"),
+                    help=f"Output directory, gets tasks/ and answers/ (default: {script_dir/'generated'})")
+    ap.add_argument("-n","--ops", type=int, default=1_000_000, help="Commands per workload (default: 1000000)")
+    ap.add_argument("-s","--seed", type=int, default=1, help="Random seed (default: 1)")
+    ap.add_argument("-d","--dist", choices=DISTS + ("all",), default="all", help="Key distribution (default: all)")
+    ap.add_argument("-q","--query-ratio", type=float, default=0.5, help="Share of queries (default: 0.5)")
+    ap.add_argument("-p","--preload", type=float, default=0.5,
+                    help="Share of the keys given before the first query (default: 0.5)")
+    ap.add_argument("-w","--width", type=float, default=1 << 20, help="Mean query width hi - lo (default: 2^20)")
+    ap.add_argument("-r","--key-range", type=int, default=10**9, help="Keys lie in [-R, R] (default: 1e9)")
+    ap.add_argument("--zipf-s", type=float, default=1.1, help="Zipf exponent (default: 1.1)")
+    ap.add_argument("--name", help="File name without .dat (default: <dist>_<ops>), only with one --dist")
+    args = ap.parse_args()
+
+    if not 0 <= args.query_ratio <= 1 or not 0 <= args.preload <= 1 or not 0 < args.key_range <= INT_MAX:
+        ap.error("query ratio and preload must lie in [0, 1], key range in (0, 2^31)")
+    if args.name and args.dist == "all":
+        ap.error("--name needs a single --dist")
+
+    out = Path(args.out)
+    for dist in (DISTS if args.dist == "all" else (args.dist,)):
+        name = (args.name or f"{dist}_{args.ops}") + ".dat"
+        ops = generate(dist, args)
+        write(out/"tasks"/name, (f"k {op[1]}\n" if op[0] == "k" else f"q {op[1]} {op[2]}\n" for op in ops))
+        write(out/"answers"/name, (f"{count} " for count in answer(ops)))
+        print(f"{out/'tasks'/name}: {len(ops)} commands", file=sys.stderr)
+
+if __name__ == "__main__":
+    main()
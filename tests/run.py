@@ -1,5 +1,5 @@
 #!/usr/bin/env python3
-import argparse, difflib, subprocess, sys
+import argparse, difflib, json, os, subprocess, sys, tempfile, time
 from pathlib import Path
 
 def color(s,c):
@@ -16,6 +16,42 @@ def resolve_from_cwd(p:str|Path)->Path:
 def default_dirs(script_dir:Path):
     return script_dir/"tasks", script_dir/"answers"
 
+def count_ops(data:bytes)->int:
+    """Number of k/q commands in a text or RBTQBIN1 task."""
+    if data.startswith(b"RBTQBIN1"):
+        ops, i = 0, 8
+        while i < len(data):
+            i += 5 if data[i:i+1] == b"k" else 9
+            ops += 1
+        return ops
+    return sum(1 for tok in data.split() if tok in (b"k", b"q"))
+
+def run_once(bin_path:Path, task:Path, pipe:bool=False):
+    """Runs BIN < task (or cat task | BIN if pipe), returns (exit code, stdout, stderr, wall seconds, peak RSS in KiB)."""
+    with task.open("rb") as fin, tempfile.TemporaryFile() as fout, tempfile.TemporaryFile() as ferr:
+        start = time.perf_counter()
+        proc = subprocess.Popen([str(bin_path)], stdin=subprocess.PIPE if pipe else fin,
+                                stdout=fout, stderr=ferr)   # run directly, no shell
+        if pipe:
+            try: proc.stdin.write(fin.read())
+            except BrokenPipeError: pass
+            proc.stdin.close()
+        _, status, usage = os.wait4(proc.pid, 0)
+        wall = time.perf_counter() - start
+        proc.returncode = os.waitstatus_to_exitcode(status)
+        fout.seek(0); ferr.seek(0)
+        return proc.returncode, fout.read(), ferr.read(), wall, usage.ru_maxrss
+
+def check_baseline(name:str, stats:dict, baseline:dict, tolerance:float)->list:
+    """Regressions of stats against baseline[name] beyond tolerance, as printable strings."""
+    base = baseline.get(name)
+    if base is None: return []
+    worse = []
+    for field, fmt in (("wall", "{:.3f} s"), ("rss_kib", "{:.0f} KiB")):
+        if field in base and stats[field] > base[field] * (1 + tolerance):
+            worse.append(f"{field} {fmt.format(stats[field])} > baseline {fmt.format(base[field])} + {tolerance:.0%}")
+    return worse
+
 def main():
     script_dir = Path(__file__).resolve().parent
     d_tests, d_keys = default_dirs(script_dir)
@@ -27,7 +63,22 @@ def main():
                     help=f"Directory with input .dat (default: {d_tests})")
     ap.add_argument("-k","--key-dir", default=str(d_keys),
                     help=f"Directory with expected .dat (default: {d_keys})")
+    ap.add_argument("--pipe", action="store_true",
+                    help="Feed tasks through a pipe instead of the file itself (the reader cannot mmap it)")
+    ap.add_argument("--time", action="store_true",
+                    help="Report wall time, peak RSS and ops/sec per task")
+    ap.add_argument("--repeat", type=int, default=1,
+                    help="Runs per task, timing keeps the fastest one (default: 1, implies --time if > 1)")
+    ap.add_argument("--baseline",
+                    help="JSON from --save-baseline: fail tasks slower or bigger than it (implies --time)")
+    ap.add_argument("--save-baseline",
+                    help="Write the measured times to this JSON file (implies --time)")
+    ap.add_argument("--tolerance", type=float, default=0.25,
+                    help="Allowed regression against --baseline (default: 0.25 = 25%%)")
     args = ap.parse_args()
+    timing = args.time or args.repeat > 1 or args.baseline or args.save_baseline
+    if args.repeat < 1:
+        print(color("ERROR: --repeat must be positive","red")); sys.exit(2)
 
     # Make paths absolute FROM CWD
     bin_path = resolve_from_cwd(args.bin)
@@ -55,6 +106,14 @@ def main():
     print(color(f"KEY_DIR: {key_dir}", "dim"))
     print()
 
+    baseline = {}
+    if args.baseline:
+        try:
+            baseline = json.loads(resolve_from_cwd(args.baseline).read_text())["tasks"]
+        except (OSError, ValueError, KeyError) as e:
+            print(color("ERROR: cannot read baseline: ","red")+str(e)); sys.exit(2)
+
+    measured = {}
     passed=failed=0
     for tf in tasks:
         name = tf.name
@@ -63,37 +122,43 @@ def main():
             print(f"[{color('FAIL','red')}] {name}  {color(f'(missing expected: {expf})','dim')}")
             failed+=1; continue
 
-        with tf.open("rb") as fin:
-            try:
-                proc = subprocess.run(
-                    [str(bin_path)],          # run directly, no shell
-                    input=fin.read(),
-                    stdout=subprocess.PIPE,
-                    stderr=subprocess.PIPE,
-                    check=False,
-                )
-            except OSError as e:
-                print(f"[{color('FAIL','red')}] {name}")
-                print("  "+color("Execution error:","yellow"), e)
-                failed+=1; continue
-
-        status_ok = (proc.returncode == 0)
-        stderr_ok = (len(proc.stderr) == 0)
-        got = proc.stdout.decode("utf-8", errors="replace")
         exp = expf.read_text(encoding="utf-8", errors="ignore")
+        exp_n = normalize(exp)
+
+        # every repetition is checked, the fastest one is reported
+        runs = []
+        try:
+            for _ in range(args.repeat):
+                returncode, stdout, stderr, wall, rss = run_once(bin_path, tf, args.pipe)
+                runs.append((wall, rss))
+                got_n = normalize(stdout.decode("utf-8", errors="replace"))
+                if returncode != 0 or stderr or got_n != exp_n: break
+        except OSError as e:
+            print(f"[{color('FAIL','red')}] {name}")
+            print("  "+color("Execution error:","yellow"), e)
+            failed+=1; continue
 
-        got_n, exp_n = normalize(got), normalize(exp)
+        status_ok = (returncode == 0)
+        stderr_ok = (len(stderr) == 0)
         stdout_ok = (got_n == exp_n)
 
-        if stdout_ok and stderr_ok and status_ok:
-            print(f"[{color('PASS','green')}] {name}")
+        stats = {"wall": min(w for w, _ in runs), "rss_kib": max(r for _, r in runs)}
+        stats["ops_per_sec"] = count_ops(tf.read_bytes()) / max(stats["wall"], 1e-9)
+        regressions = check_baseline(name, stats, baseline, args.tolerance) if stdout_ok and stderr_ok and status_ok else []
+        timing_note = color(f"  {stats['wall']*1e3:9.1f} ms  {stats['rss_kib']/1024:8.1f} MiB  {stats['ops_per_sec']/1e6:8.2f} Mops/s", "dim") if timing else ""
+
+        if stdout_ok and stderr_ok and status_ok and not regressions:
+            print(f"[{color('PASS','green')}] {name}{timing_note}")
+            measured[name] = stats
             passed+=1
         else:
-            print(f"[{color('FAIL','red')}] {name}")
+            print(f"[{color('FAIL','red')}] {name}{timing_note}")
+            for regression in regressions:
+                print(f"  {color('Regression:','yellow')} {regression}")
             if not status_ok:
-                print(f"  {color('Exit status:','yellow')} {proc.returncode}")
+                print(f"  {color('Exit status:','yellow')} {returncode}")
             if not stderr_ok:
-                err = "\n".join(proc.stderr.decode(errors="replace").splitlines()[:5])
+                err = "\n".join(stderr.decode(errors="replace").splitlines()[:5])
                 print(f"  {color('Stderr (first 5 lines):','yellow')}\n    "+err.replace("\n","\n    "))
             if not stdout_ok:
                 diff = difflib.unified_diff(
@@ -107,6 +172,10 @@ def main():
                 if sys.stdout.tell() == 0: pass
             failed+=1
 
+    if args.save_baseline:
+        resolve_from_cwd(args.save_baseline).write_text(json.dumps({"bin": str(bin_path), "repeat": args.repeat, "tasks": measured}, indent=2) + "\n")
+        print(color(f"\nbaseline written: {args.save_baseline} ({len(measured)} passed tasks)", "dim"))
+
     print(f"\nTotal: {passed+failed}  {color('pass:','green')} {passed}  {color('fail:','red')} {failed}")
     sys.exit(0 if failed==0 else 1)
 
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RedBlackTree/compact_tree.hpp"
+
+// CompactTree against std::set: inserts and erases, hinted inserts down to the begin() hint,
+// and a comparator that belongs to each tree and is copied and moved with it.
+
+namespace {
+
+using Compact = Trees::RBT::CompactTree<int, std::greater<int>>;
+
+// std::greater<int> that counts its own calls
+struct CountingGreater
+{
+    mutable std::size_t calls = 0;
+
+    bool operator()(int lhs, int rhs) const { ++calls; return lhs > rhs; }
+};
+
+using Counting = Trees::RBT::CompactTree<int, CountingGreater>;
+
+void ExpectSame(const auto& tree, const std::set<int>& expected)
+{
+    ASSERT_EQ(tree.size(), expected.size());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+}
+
+}
+
+TEST(CompactTree, InsertEraseMatchStdSet)
+{
+    std::mt19937  rng(3);
+    Compact       tree;
+    std::set<int> expected;
+
+    for (int op = 0; op < 50000; ++op)
+    {
+        int key = static_cast<int>(rng() % 5000);
+
+        if (rng() % 3 != 0)
+        {
+            tree.insert(key);
+            expected.insert(key);
+        }
+        else
+        {
+            tree.erase(key);
+            expected.erase(key);
+        }
+    }
+
+    ExpectSame(tree, expected);
+}
+
+TEST(CompactTree, HintedInsert)
+{
+    std::mt19937  rng(4);
+    Compact       tree;
+    std::set<int> expected;
+
+    // right hints, wrong hints, begin() and end()
+    for (int op = 0; op < 20000; ++op)
+    {
+        int key = static_cast<int>(rng() % 10000);
+
+        Compact::const_iterator hint;
+
+        switch (op % 4)
+        {
+            case 0:  hint = tree.LowerBound(key); break;
+            case 1:  hint = tree.begin();         break;
+            case 2:  hint = tree.end();           break;
+            default: hint = tree.LowerBound(static_cast<int>(rng() % 10000));
+        }
+
+        EXPECT_EQ(*tree.insert(hint, key), key);
+        expected.insert(key);
+    }
+
+    ExpectSame(tree, expected);
+}
+
+TEST(CompactTree, BeginHintForANewMinimum)
+{
+    Counting tree;
+
+    // into an empty tree, where begin() == end()
+    tree.insert(tree.begin(), 50);
+
+    for (int key = 49; key >= 0; --key)
+    {
+        std::size_t calls = tree.key_comp().calls;
+
+        // the first key has no predecessor: one comparison with the hint, no descent, no decrement
+        auto it = tree.insert(tree.begin(), key);
+
+        ASSERT_EQ(*it, key);
+        ASSERT_EQ(it, tree.begin());
+        ASSERT_EQ(tree.key_comp().calls - calls, 1u);
+    }
+
+    std::vector<int> keys(tree.begin(), tree.end());
+
+    ASSERT_EQ(keys.size(), 51u);
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+    // a begin() hint that is wrong still inserts where the key belongs
+    tree.insert(tree.begin(), 25);
+    tree.insert(tree.begin(), 100);
+
+    EXPECT_EQ(tree.size(), 52u);
+    EXPECT_EQ(tree.back(), 100);
+}
+
+TEST(CompactTree, ComparatorBelongsToTheTree)
+{
+    Counting first;
+    Counting second;
+
+    for (int key = 0; key < 1000; ++key)
+        first.insert(key);
+
+    std::size_t first_calls = first.key_comp().calls;
+
+    EXPECT_GT(first_calls, 0u);
+    EXPECT_EQ(second.key_comp().calls, 0u);
+
+    // copies and moves take the comparator with its state
+    Counting copy = first;
+
+    EXPECT_EQ(copy.key_comp().calls, first_calls);
+
+    copy.insert(-1);
+
+    EXPECT_GT(copy .key_comp().calls, first_calls);
+    EXPECT_EQ(first.key_comp().calls, first_calls);
+
+    std::size_t copy_calls = copy.key_comp().calls;
+    Counting    moved      = std::move(copy);
+
+    EXPECT_EQ(moved.key_comp().calls, copy_calls);
+
+    second = first;
+    EXPECT_EQ(second.key_comp().calls, first_calls);
+
+    // trees written on different threads share no comparator state
+    std::thread other([&] { for (int key = 0; key < 20000; ++key) second.insert(key); });
+
+    for (int key = 0; key < 20000; ++key)
+        moved.insert(-key);
+
+    other.join();
+
+    EXPECT_EQ(second.size(), 20000u);
+    EXPECT_EQ(moved .size(), 20999u);
+    EXPECT_EQ(first.key_comp().calls, first_calls);
+}
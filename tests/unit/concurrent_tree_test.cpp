@@ -0,0 +1,152 @@
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RedBlackTree/concurrent_tree.hpp"
+
+// Readers and writers on one ConcurrentTree at once. Even keys are loaded up front and never
+// touched, writers insert and erase odd keys, so every read has an answer that holds whatever
+// the writers did meanwhile. Built twice: concurrent_tree_test and, with -fsanitize=thread,
+// concurrent_tree_test_tsan, which also reports any unsynchronized access.
+
+namespace {
+
+using Conc = Trees::RBT::ConcurrentTree<int, std::greater<int>>;
+
+constexpr int      KEY_RANGE = 4096;
+constexpr unsigned WRITERS   = 3;
+constexpr unsigned READERS   = 3;
+constexpr int      WRITES    = 4000;
+
+std::vector<int> EvenKeys()
+{
+    std::vector<int> keys;
+
+    for (int key = 0; key < KEY_RANGE; key += 2)
+        keys.push_back(key);
+
+    return keys;
+}
+
+}
+
+TEST(ConcurrentTree, ReadsSeeStableKeysWhileWritersRun)
+{
+    std::vector<int> evens = EvenKeys();
+    Conc             tree(evens.begin(), evens.end());
+
+    std::atomic<bool>     writing = true;
+    std::atomic<unsigned> errors  = 0;
+
+    // writer t owns the odd keys equal to 2 * t + 1 modulo 2 * WRITERS and keeps its own model of them
+    std::vector<std::set<int>> owned(WRITERS);
+    std::vector<std::thread>   writers;
+
+    for (unsigned t = 0; t < WRITERS; ++t)
+        writers.emplace_back([&, t]
+        {
+            std::mt19937 rng(t + 1);
+
+            for (int i = 0; i < WRITES; ++i)
+            {
+                int  key = static_cast<int>((rng() % (KEY_RANGE / (2 * WRITERS))) * 2 * WRITERS + 2 * t + 1);
+                bool add = rng() % 2 == 0;
+
+                bool changed  = add ? tree.insert(key) : tree.erase(key);
+                bool expected = add ? owned[t].insert(key).second : owned[t].erase(key) == 1;
+
+                if (changed != expected)
+                    ++errors;
+            }
+        });
+
+    std::vector<std::thread> readers;
+
+    for (unsigned t = 0; t < READERS; ++t)
+        readers.emplace_back([&, t]
+        {
+            std::mt19937 rng(100 + t);
+
+            while (writing.load(std::memory_order_relaxed))
+            {
+                // keys near the top are left out, so [even, even + 64] always holds 33 stable keys
+                int even = static_cast<int>(rng() % ((KEY_RANGE - 66) / 2)) * 2;
+                int odd  = even + 1;
+
+                // each check is one read: the next key after an even one is the odd key, if
+                // a writer has it in the tree right now, or the next even key
+                std::optional<int> lower = tree.LowerBound(odd);
+                std::optional<int> upper = tree.UpperBound(even);
+                std::size_t        count = tree.CountInRange(even, even + 64);
+                std::size_t        size  = tree.size();
+
+                bool ok = tree.contains(even) && tree.find(even) == even && tree.LowerBound(even) == even &&
+                          lower && (*lower == odd || *lower == odd + 1) &&
+                          upper && (*upper == odd || *upper == odd + 1) &&
+                          tree.Rank(even) >= static_cast<std::size_t>(even / 2) &&
+                          count >= 33 && count <= 65 &&
+                          size >= evens.size() && size <= static_cast<std::size_t>(KEY_RANGE);
+
+                if (!ok)
+                    ++errors;
+            }
+        });
+
+    for (std::thread& writer : writers)
+        writer.join();
+
+    writing = false;
+
+    for (std::thread& reader : readers)
+        reader.join();
+
+    EXPECT_EQ(errors.load(), 0u);
+
+    // the final contents are the even keys and what each writer's model says
+    std::set<int> expected(evens.begin(), evens.end());
+
+    for (const std::set<int>& keys : owned)
+        expected.insert(keys.begin(), keys.end());
+
+    ASSERT_EQ(tree.size(), expected.size());
+
+    for (int key = -1; key <= KEY_RANGE; ++key)
+        EXPECT_EQ(tree.contains(key), expected.count(key) == 1) << "key " << key;
+}
+
+TEST(ConcurrentTree, BatchWritersAndRangeCounts)
+{
+    Conc tree;
+
+    std::vector<std::thread> writers;
+
+    // every thread inserts a disjoint block of keys in batches
+    for (int t = 0; t < 4; ++t)
+        writers.emplace_back([&, t]
+        {
+            for (int batch = 0; batch < 50; ++batch)
+            {
+                std::vector<int> keys;
+
+                for (int i = 0; i < 20; ++i)
+                    keys.push_back(t * 1000 + batch * 20 + i);
+
+                tree.InsertBatch(keys);
+                tree.CountInRange(t * 1000, t * 1000 + 999);
+            }
+        });
+
+    for (std::thread& writer : writers)
+        writer.join();
+
+    EXPECT_EQ(tree.size(), 4000u);
+
+    for (int t = 0; t < 4; ++t)
+        EXPECT_EQ(tree.CountInRange(t * 1000, t * 1000 + 999), 1000u);
+}
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RedBlackTree/tree.hpp"
+
+// insert(KeyT&&), emplace, emplace_hint and try_emplace: where the key ends up, and how many
+// keys are built on the way.
+
+namespace {
+
+// counts how its keys are made, so a test can tell a copy, a move and nothing apart
+struct Counted
+{
+    static inline int constructions = 0;
+    static inline int copies        = 0;
+
+    int value = 0;
+
+    Counted() = default;     // for the nil node
+    Counted(int value_) : value(value_) { ++constructions; }
+    Counted(const Counted& other) : value(other.value) { ++copies; }
+    Counted(Counted&& other) noexcept = default;
+
+    Counted& operator=(const Counted&) = default;
+    Counted& operator=(Counted&&)      = default;
+
+    static void Reset() { constructions = copies = 0; }
+};
+
+// compares Counted with plain ints too, so looking an int up builds no Counted
+struct CountedGreater
+{
+    using is_transparent = void;
+
+    bool operator()(const Counted& lhs, const Counted& rhs) const { return lhs.value > rhs.value; }
+    bool operator()(const Counted& lhs, int rhs)            const { return lhs.value > rhs; }
+    bool operator()(int lhs, const Counted& rhs)            const { return lhs > rhs.value; }
+};
+
+using IntTree     = Trees::RBT::Tree<int, std::greater<int>>;
+using CountedTree = Trees::RBT::Tree<Counted, CountedGreater>;
+using StringTree  = Trees::RBT::Tree<std::string, std::greater<>>;
+
+template <typename TreeT>
+concept TryEmplaceTakesExtraArgs = requires(TreeT tree) { tree.try_emplace(55, 5); };
+
+std::vector<int> Keys(const IntTree& tree)
+{
+    return std::vector<int>(tree.begin(), tree.end());
+}
+
+IntTree Tens()
+{
+    IntTree tree;
+
+    for (int key = 0; key < 100; key += 10)
+        tree.insert(key);
+
+    return tree;
+}
+
+}
+
+TEST(Emplace, TryEmplacePlacesTheKeyItWasGiven)
+{
+    // the position is found for the key, so the node may be built from nothing else
+    static_assert(!TryEmplaceTakesExtraArgs<IntTree>);
+
+    IntTree tree = Tens();
+
+    auto [it, inserted] = tree.try_emplace(55);
+
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(*it, 55);
+    EXPECT_TRUE(tree.IsValid());
+    EXPECT_NE(tree.find(55), tree.end());
+    EXPECT_EQ(Keys(tree), (std::vector<int>{0, 10, 20, 30, 40, 50, 55, 60, 70, 80, 90}));
+
+    auto [present, again] = tree.try_emplace(55);
+
+    EXPECT_FALSE(again);
+    EXPECT_EQ(present, it);
+    EXPECT_EQ(tree.size(), 11u);
+}
+
+TEST(Emplace, TryEmplaceBuildsNothingForAPresentKey)
+{
+    CountedTree tree;
+
+    for (int value : {5, 1, 9})
+        tree.emplace(value);
+
+    Counted::Reset();
+
+    // the int is compared as it is: no Counted exists until a node needs one
+    auto [it, inserted] = tree.try_emplace(5);
+
+    EXPECT_FALSE(inserted);
+    EXPECT_EQ(it->value, 5);
+    EXPECT_EQ(Counted::constructions, 0);
+
+    auto [added, is_new] = tree.try_emplace(7);
+
+    EXPECT_TRUE(is_new);
+    EXPECT_EQ(added->value, 7);
+    EXPECT_EQ(Counted::constructions, 1);
+    EXPECT_EQ(Counted::copies, 0);
+    EXPECT_EQ(tree.size(), 4u);
+    EXPECT_TRUE(tree.IsValid());
+}
+
+TEST(Emplace, KeysAreMovedOrBuiltInPlace)
+{
+    CountedTree tree;
+
+    Counted::Reset();
+
+    tree.emplace(3);
+    tree.insert(Counted(1));
+    tree.emplace_hint(tree.end(), 8);
+    tree.emplace_hint(tree.begin(), 0);
+
+    Counted four(4);
+    tree.insert(tree.find(Counted(8)), std::move(four));
+
+    EXPECT_EQ(Counted::copies, 0);
+
+    std::vector<int> values;
+    for (const Counted& key : tree)
+        values.push_back(key.value);
+
+    EXPECT_EQ(values, (std::vector<int>{0, 1, 3, 4, 8}));
+    EXPECT_TRUE(tree.IsValid());
+
+    // only an explicit copy copies
+    Counted two(2);
+    tree.insert(two);
+
+    EXPECT_EQ(Counted::copies, 1);
+}
+
+TEST(Emplace, StringKeysFromViews)
+{
+    StringTree tree;
+
+    std::string long_key(100, 'x');
+
+    tree.insert(std::string(long_key));
+    tree.emplace(50, 'y');
+    tree.emplace_hint(tree.begin(), "a");
+
+    auto [it, inserted] = tree.try_emplace(std::string_view("m"));
+
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(*it, "m");
+    EXPECT_FALSE(tree.try_emplace(std::string_view(long_key)).second);
+
+    std::vector<std::string> expected = {"a", "m", long_key, std::string(50, 'y')};
+
+    EXPECT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+    EXPECT_TRUE(tree.IsValid());
+}
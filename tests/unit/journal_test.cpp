@@ -0,0 +1,364 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RedBlackTree/journal.hpp"
+
+// Journal and DurableTree: replay against a std::set fed the same operations, a torn or
+// garbage tail cut off (and reported) by Open with appends going on after it, the errors
+// of each kind of failure, and recovery from a snapshot plus the journal.
+
+namespace {
+
+using Tree    = Trees::RBT::Tree<int, std::greater<int>>;
+using Journal = Trees::RBT::Journal<int>;
+using Op      = Journal::Op;
+using Durable = Trees::RBT::DurableTree<int, std::greater<int>>;
+
+// batches are written only on Sync, so every Sync closes exactly one batch
+const Trees::RBT::JournalOptions ONE_BATCH_PER_SYNC = {std::size_t(1) << 20, std::chrono::hours(1), std::size_t(1) << 20};
+
+class JournalTest : public ::testing::Test
+{
+protected:
+    std::string journal_path  = ::testing::TempDir() + "journal_test_" + std::to_string(::getpid()) + ".log";
+    std::string snapshot_path = ::testing::TempDir() + "journal_test_" + std::to_string(::getpid()) + ".tree";
+
+    void SetUp   () override { Remove(); }
+    void TearDown() override { Remove(); }
+
+    void Remove()
+    {
+        ::unlink(journal_path .c_str());
+        ::unlink(snapshot_path.c_str());
+    }
+
+    std::size_t FileSize() const
+    {
+        struct stat info = {};
+
+        return ::stat(journal_path.c_str(), &info) == 0 ? static_cast<std::size_t>(info.st_size) : 0;
+    }
+
+    void Truncate(std::size_t size) const { ASSERT_EQ(::truncate(journal_path.c_str(), static_cast<off_t>(size)), 0); }
+
+    void AppendBytes(const std::string& bytes) const
+    {
+        int fd = ::open(journal_path.c_str(), O_WRONLY | O_APPEND);
+
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(::write(fd, bytes.data(), bytes.size()), static_cast<ssize_t>(bytes.size()));
+        ::close(fd);
+    }
+
+    // appends count random records to journal and model
+    static void AppendRandom(Journal& journal, std::set<int>& model, std::mt19937& rng, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            int  key    = static_cast<int>(rng() % 3000);
+            bool insert = rng() % 3 != 0;
+
+            journal.Append(insert ? Op::INSERT : Op::ERASE, key);
+
+            if (insert)
+                model.insert(key);
+            else
+                model.erase(key);
+        }
+    }
+};
+
+bool Same(const Tree& tree, const std::set<int>& model)
+{
+    return tree.IsValid() && tree.size() == model.size() && std::equal(tree.begin(), tree.end(), model.begin());
+}
+
+}
+
+TEST_F(JournalTest, ReplayMatchesTheOperations)
+{
+    std::mt19937    rng(25);
+    std::set<int>   model;
+    std::error_code error;
+
+    {
+        // small groups and a short interval, so the records span many batches
+        std::unique_ptr<Journal> journal = Journal::Open(journal_path, error, {64, std::chrono::milliseconds(1), 1024});
+
+        ASSERT_TRUE(journal) << error.message();
+        EXPECT_EQ(journal->TornBytes(), 0u);
+
+        for (int part = 0; part < 4; ++part)
+        {
+            AppendRandom(*journal, model, rng, 5000);
+            ASSERT_TRUE(journal->Sync());
+        }
+
+        EXPECT_FALSE(journal->Failed());
+        EXPECT_FALSE(journal->Error());
+    }
+
+    Tree tree;
+
+    std::optional<std::size_t> read = Journal::Replay(journal_path, tree, error);
+
+    ASSERT_TRUE(read) << error.message();
+    EXPECT_EQ(*read, 20000u);
+    EXPECT_TRUE(Same(tree, model));
+
+    // over a tree that already has keys, the records decide only the keys they mention
+    std::set<int> base_model;
+    Tree          base;
+
+    for (int key = 2000; key < 6000; key += 7)
+    {
+        base.insert(key);
+        base_model.insert(key);
+    }
+
+    ASSERT_TRUE(Journal::Replay(journal_path, base, error));
+
+    for (int key = 0; key < 6000; ++key)
+    {
+        bool expected = key < 3000 ? model.count(key) == 1 : base_model.count(key) == 1;
+
+        ASSERT_EQ(base.find(key) != base.end(), expected) << "key " << key;
+    }
+}
+
+TEST_F(JournalTest, TornTailIsCutOffAndReported)
+{
+    std::mt19937    rng(26);
+    std::set<int>   model;
+    std::error_code error;
+
+    std::size_t intact_size = 0;
+
+    {
+        std::unique_ptr<Journal> journal = Journal::Open(journal_path, error, ONE_BATCH_PER_SYNC);
+        ASSERT_TRUE(journal) << error.message();
+
+        for (int part = 0; part < 3; ++part)
+        {
+            AppendRandom(*journal, model, rng, 1000);
+            ASSERT_TRUE(journal->Sync());
+        }
+
+        intact_size = FileSize();
+
+        // the last batch, torn by a crash below
+        std::set<int> lost = model;
+        AppendRandom(*journal, lost, rng, 1000);
+        ASSERT_TRUE(journal->Sync());
+    }
+
+    std::size_t full_size = FileSize();
+
+    Truncate(full_size - 3);
+
+    // replay stops before the torn batch
+    Tree tree;
+
+    std::optional<std::size_t> read = Journal::Replay(journal_path, tree, error);
+
+    ASSERT_TRUE(read) << error.message();
+    EXPECT_EQ(*read, 3000u);
+    EXPECT_TRUE(Same(tree, model));
+
+    // Open cuts it off, says how much it dropped and appends after the intact batches
+    {
+        std::unique_ptr<Journal> journal = Journal::Open(journal_path, error, ONE_BATCH_PER_SYNC);
+
+        ASSERT_TRUE(journal) << error.message();
+        EXPECT_EQ(journal->TornBytes(), full_size - 3 - intact_size);
+        EXPECT_EQ(FileSize(), intact_size);
+
+        journal->Append(Op::INSERT, 99999);
+        model.insert(99999);
+        ASSERT_TRUE(journal->Sync());
+    }
+
+    // garbage after the last batch is a torn tail as well
+    AppendBytes("garbage, not a batch header");
+
+    {
+        std::unique_ptr<Journal> journal = Journal::Open(journal_path, error);
+
+        ASSERT_TRUE(journal) << error.message();
+        EXPECT_EQ(journal->TornBytes(), sizeof("garbage, not a batch header") - 1);
+    }
+
+    // a clean file reports nothing
+    std::unique_ptr<Journal> journal = Journal::Open(journal_path, error);
+
+    ASSERT_TRUE(journal) << error.message();
+    EXPECT_EQ(journal->TornBytes(), 0u);
+
+    Tree replayed;
+
+    read = Journal::Replay(journal_path, replayed, error);
+
+    ASSERT_TRUE(read) << error.message();
+    EXPECT_EQ(*read, 3001u);
+    EXPECT_TRUE(Same(replayed, model));
+}
+
+TEST_F(JournalTest, ReportsWhyItFailed)
+{
+    std::error_code error;
+    Tree            tree;
+
+    EXPECT_FALSE(Journal::Replay(journal_path, tree, error));
+    EXPECT_EQ(error, std::errc::no_such_file_or_directory);
+
+    EXPECT_FALSE(Journal::Open(::testing::TempDir() + "no/such/dir.log", error));
+    EXPECT_EQ(error, std::errc::no_such_file_or_directory);
+
+    ASSERT_TRUE(Journal::Open(journal_path, error));
+
+    // the header records the key size
+    error.clear();
+    EXPECT_FALSE(Trees::RBT::Journal<long long>::Open(journal_path, error));
+    EXPECT_EQ(error, Trees::RBT::FileIO::Error::WRONG_FORMAT);
+
+    // another kind of file is left as it is
+    Truncate(0);
+    AppendBytes("not a journal, but long enough for a header");
+
+    std::size_t size = FileSize();
+
+    error.clear();
+    EXPECT_FALSE(Journal::Open(journal_path, error));
+    EXPECT_EQ(error, Trees::RBT::FileIO::Error::WRONG_FORMAT);
+    EXPECT_EQ(FileSize(), size);
+
+    error.clear();
+    EXPECT_FALSE(Journal::Replay(journal_path, tree, error));
+    EXPECT_EQ(error, Trees::RBT::FileIO::Error::WRONG_FORMAT);
+}
+
+TEST_F(JournalTest, ConcurrentWaitersShareSyncs)
+{
+    constexpr int THREADS = 8;
+    constexpr int RECORDS = 200;
+
+    std::error_code error;
+
+    {
+        std::unique_ptr<Journal> journal = Journal::Open(journal_path, error);
+        ASSERT_TRUE(journal) << error.message();
+
+        std::vector<std::thread> threads;
+        std::vector<int>         failures(THREADS, 0);
+
+        for (int t = 0; t < THREADS; ++t)
+            threads.emplace_back([&, t]
+            {
+                for (int i = 0; i < RECORDS; ++i)
+                    failures[t] += !journal->WaitDurable(journal->Append(Op::INSERT, t * 1000 + i));
+            });
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        EXPECT_EQ(std::count(failures.begin(), failures.end(), 0), THREADS);
+        EXPECT_LE(journal->SyncCount(), static_cast<std::uint64_t>(THREADS * RECORDS));
+    }
+
+    Tree tree;
+
+    std::optional<std::size_t> read = Journal::Replay(journal_path, tree, error);
+
+    ASSERT_TRUE(read) << error.message();
+    EXPECT_EQ(*read, static_cast<std::size_t>(THREADS * RECORDS));
+    EXPECT_EQ(tree.size(), static_cast<std::size_t>(THREADS * RECORDS));
+}
+
+TEST_F(JournalTest, DurableTreeRecoversFromSnapshotAndJournal)
+{
+    std::mt19937    rng(27);
+    std::set<int>   model;
+    std::error_code error;
+
+    {
+        std::optional<Durable> durable = Durable::Open(snapshot_path, journal_path, error);
+        ASSERT_TRUE(durable) << error.message();
+
+        for (int i = 0; i < 10000; ++i)
+        {
+            int key = static_cast<int>(rng() % 2000);
+
+            if (rng() % 3 != 0)
+            {
+                ASSERT_EQ(durable->insert(key), model.insert(key).second);
+            }
+            else
+            {
+                ASSERT_EQ(durable->erase(key), model.erase(key) == 1);
+            }
+        }
+
+        ASSERT_TRUE(durable->Checkpoint(error)) << error.message();
+        EXPECT_FALSE(error);
+
+        // the snapshot holds everything, the journal is back to its header
+        Tree snapshot;
+        ASSERT_TRUE(Journal::Replay(journal_path, snapshot, error));
+        EXPECT_TRUE(snapshot.empty());
+
+        std::vector<int> batch;
+        for (int i = 0; i < 500; ++i)
+            batch.push_back(static_cast<int>(rng() % 4000));
+
+        durable->InsertBatch(batch);
+        model.insert(batch.begin(), batch.end());
+
+        for (int i = 0; i < 3000; ++i)
+        {
+            int key = static_cast<int>(rng() % 4000);
+
+            durable->erase(key);
+            model.erase(key);
+        }
+
+        EXPECT_TRUE(Same(durable->tree(), model));
+        ASSERT_TRUE(durable->Sync());
+    }
+
+    {
+        std::optional<Durable> durable = Durable::Open(snapshot_path, journal_path, error);
+
+        ASSERT_TRUE(durable) << error.message();
+        EXPECT_TRUE(Same(durable->tree(), model));
+        EXPECT_EQ(durable->journal().TornBytes(), 0u);
+
+        durable->insert(-5);
+        model.insert(-5);
+    }
+
+    std::optional<Durable> durable = Durable::Open(snapshot_path, journal_path, error);
+
+    ASSERT_TRUE(durable) << error.message();
+    EXPECT_TRUE(Same(durable->tree(), model));
+
+    // a snapshot of another format stops the recovery with its error
+    durable.reset();
+    Truncate(0);
+    ASSERT_EQ(::truncate(snapshot_path.c_str(), 10), 0);
+
+    EXPECT_FALSE(Durable::Open(snapshot_path, journal_path, error));
+    EXPECT_EQ(error, Trees::RBT::FileIO::Error::WRONG_FORMAT);
+}
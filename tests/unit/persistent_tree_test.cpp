@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RedBlackTree/persistent_tree.hpp"
+
+// PersistentTree and its snapshots against std::set: random inserts and erases, snapshots
+// taken on the way that must not change with later writes, the snapshot queries, and
+// readers scanning snapshots while writers go on (run under TSan as persistent_tree_test_tsan).
+
+namespace {
+
+using PTree    = Trees::RBT::PersistentTree<int, std::greater<int>>;
+using Snapshot = PTree::Snapshot_t;
+
+void ExpectSame(const Snapshot& snapshot, const std::set<int>& expected)
+{
+    ASSERT_TRUE(snapshot.IsValid());
+    ASSERT_EQ(snapshot.size(), expected.size());
+    ASSERT_EQ(snapshot.empty(), expected.empty());
+    ASSERT_TRUE(std::equal(snapshot.begin(), snapshot.end(), expected.begin(), expected.end()));
+}
+
+// the key an iterator points to, or end_key for end()
+int KeyOr(const Snapshot& snapshot, Snapshot::const_iterator it, int end_key)
+{
+    return it == snapshot.end() ? end_key : *it;
+}
+
+int KeyOr(const std::set<int>& set, std::set<int>::const_iterator it, int end_key)
+{
+    return it == set.end() ? end_key : *it;
+}
+
+}
+
+TEST(PersistentTree, InsertEraseMatchStdSet)
+{
+    std::mt19937 rng(14);
+
+    for (int key_range : {10, 1000, 100000})
+    {
+        std::vector<int> initial;
+        for (int i = 0; i < key_range / 2; ++i)
+            initial.push_back(static_cast<int>(rng() % static_cast<unsigned>(key_range)));
+
+        // unsorted and with duplicates
+        PTree         tree(initial.begin(), initial.end());
+        std::set<int> expected(initial.begin(), initial.end());
+
+        ExpectSame(tree.Snapshot(), expected);
+
+        for (int op = 0; op < 20000; ++op)
+        {
+            int key = static_cast<int>(rng() % static_cast<unsigned>(key_range));
+
+            if (rng() % 2 == 0)
+                ASSERT_EQ(tree.insert(key), expected.insert(key).second) << "insert " << key;
+            else
+                ASSERT_EQ(tree.erase(key), expected.erase(key) == 1) << "erase " << key;
+
+            ASSERT_EQ(tree.size(), expected.size());
+
+            if (op % 1000 == 0)
+                ExpectSame(tree.Snapshot(), expected);
+        }
+
+        ExpectSame(tree.Snapshot(), expected);
+
+        // down to empty and up again
+        for (int key : std::vector<int>(expected.begin(), expected.end()))
+            ASSERT_TRUE(tree.erase(key));
+
+        ExpectSame(tree.Snapshot(), {});
+        EXPECT_FALSE(tree.erase(0));
+
+        for (int key = key_range; key > 0; --key)
+            ASSERT_TRUE(tree.insert(key));
+
+        ASSERT_TRUE(tree.Snapshot().IsValid());
+        EXPECT_EQ(tree.size(), static_cast<std::size_t>(key_range));
+    }
+}
+
+TEST(PersistentTree, SnapshotsKeepTheirVersion)
+{
+    std::mt19937 rng(15);
+
+    std::vector<std::pair<Snapshot, std::set<int>>> versions;
+
+    std::optional<Snapshot> survivor;
+    std::set<int>           survivor_keys;
+
+    {
+        PTree         tree;
+        std::set<int> expected;
+
+        versions.emplace_back(tree.Snapshot(), expected);
+
+        for (int op = 0; op < 30000; ++op)
+        {
+            int key = static_cast<int>(rng() % 5000);
+
+            if (rng() % 3 != 0)
+            {
+                tree.insert(key);
+                expected.insert(key);
+            }
+            else
+            {
+                tree.erase(key);
+                expected.erase(key);
+            }
+
+            if (op % 3000 == 1)
+                versions.emplace_back(tree.Snapshot(), expected);
+        }
+
+        // every version taken on the way still holds what it held then
+        for (const auto& [snapshot, keys] : versions)
+            ExpectSame(snapshot, keys);
+
+        // a snapshot outlives the tree that made it
+        survivor      = tree.Snapshot();
+        survivor_keys = expected;
+    }
+
+    ExpectSame(*survivor, survivor_keys);
+
+    // dropping the older versions leaves the newer ones intact
+    for (std::size_t i = 0; i + 1 < versions.size(); ++i)
+    {
+        versions[i].first = Snapshot();
+
+        ExpectSame(versions[i + 1].first, versions[i + 1].second);
+        EXPECT_TRUE(versions[i].first.empty());
+    }
+}
+
+TEST(PersistentTree, QueriesMatchStdSet)
+{
+    std::mt19937 rng(16);
+
+    for (std::size_t size : {0u, 1u, 2u, 100u, 20000u})
+    {
+        std::set<int> expected;
+
+        while (expected.size() < size)
+            expected.insert(static_cast<int>(rng() % 100000) * 2);       // even keys, odd queries fall between them
+
+        PTree    tree(expected.begin(), expected.end());
+        Snapshot snapshot = tree.Snapshot();
+
+        ASSERT_TRUE(snapshot.IsValid());
+
+        std::vector<int> queries = {-1, 0, 1, 199999, 200000, 200001};
+        for (int i = 0; i < 2000; ++i)
+            queries.push_back(static_cast<int>(rng() % 200010) - 5);
+
+        for (int key : queries)
+        {
+            ASSERT_EQ(KeyOr(snapshot, snapshot.LowerBound(key), -100), KeyOr(expected, expected.lower_bound(key), -100)) << key;
+            ASSERT_EQ(KeyOr(snapshot, snapshot.UpperBound(key), -100), KeyOr(expected, expected.upper_bound(key), -100)) << key;
+            ASSERT_EQ(KeyOr(snapshot, snapshot.find(key),       -100), KeyOr(expected, expected.find(key),        -100)) << key;
+
+            ASSERT_EQ(snapshot.Rank(key), static_cast<std::size_t>(std::distance(expected.begin(), expected.lower_bound(key)))) << key;
+
+            // iterating on from a bound walks the rest of the keys
+            auto it = snapshot.LowerBound(key);
+            ASSERT_TRUE(std::equal(it, snapshot.end(), expected.lower_bound(key), expected.end())) << key;
+
+            int hi = key + static_cast<int>(rng() % 5000) - 100;
+
+            std::size_t in_range = (key > hi) ? 0 : static_cast<std::size_t>(std::distance(expected.lower_bound(key), expected.upper_bound(hi)));
+
+            ASSERT_EQ(snapshot.CountInRange(key, hi), in_range) << key << ' ' << hi;
+        }
+    }
+}
+
+// two writers, each inserting then erasing a block of keys in order, so every version holds
+// one contiguous run of each block; readers scan snapshots and check that run
+TEST(PersistentTree, ReadersSeeWholeVersionsWhileWritersGoOn)
+{
+    constexpr int BLOCK   = 3000;
+    constexpr int READERS = 3;
+
+    PTree tree;
+
+    std::atomic<int>  writers_left = 2;
+    std::atomic<bool> broken       = false;
+
+    auto writer = [&](int base)
+    {
+        for (int key = base; key < base + BLOCK; ++key)
+            tree.insert(key);
+
+        for (int key = base; key < base + BLOCK; ++key)
+            tree.erase(key);
+
+        writers_left--;
+    };
+
+    // the keys of [base, base + BLOCK) in the snapshot form one run without gaps
+    auto run_is_whole = [](const Snapshot& snapshot, int base)
+    {
+        std::size_t count = snapshot.CountInRange(base, base + BLOCK - 1);
+
+        if (count == 0)
+            return true;
+
+        int first = *snapshot.LowerBound(base);
+        int last  = first + static_cast<int>(count) - 1;
+
+        return snapshot.find(last) != snapshot.end() && snapshot.CountInRange(first, last) == count &&
+               snapshot.Rank(last) - snapshot.Rank(first) == count - 1;
+    };
+
+    std::vector<std::thread> threads;
+
+    for (int r = 0; r < READERS; ++r)
+    {
+        threads.emplace_back([&]
+        {
+            std::size_t scans = 0;
+
+            while (writers_left > 0 || scans == 0)
+            {
+                Snapshot snapshot = tree.Snapshot();
+
+                // a full scan sees exactly size() keys in order
+                std::size_t seen = 0;
+                int         prev = -1;
+
+                for (int key : snapshot)
+                {
+                    if (key <= prev)
+                        broken = true;
+
+                    prev = key;
+                    ++seen;
+                }
+
+                if (seen != snapshot.size() || !run_is_whole(snapshot, 0) || !run_is_whole(snapshot, 1 << 20))
+                    broken = true;
+
+                ++scans;
+            }
+        });
+    }
+
+    threads.emplace_back(writer, 0);
+    threads.emplace_back(writer, 1 << 20);
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    EXPECT_FALSE(broken);
+    EXPECT_EQ(tree.size(), 0u);
+    EXPECT_TRUE(tree.Snapshot().IsValid());
+}
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RedBlackTree/tree.hpp"
+
+// erase(first, last), EraseRange and ExtractRange against the same erase on std::set: the
+// returned counts, the sizes and keys of both trees and their invariants (Tree::IsValid).
+// Each tree goes on being used afterwards, so nodes handed between trees are checked too, and
+// an extracted range is written on another thread than its source (range_erase_test_tsan).
+
+namespace {
+
+using Tree = Trees::RBT::Tree<int, std::greater<int>>;
+
+struct Range
+{
+    int lo;
+    int hi;
+};
+
+std::set<int> RandomSet(std::mt19937& rng, std::size_t count, int key_range)
+{
+    std::set<int> keys;
+
+    while (keys.size() < count)
+        keys.insert(static_cast<int>(rng() % static_cast<unsigned>(key_range)));
+
+    return keys;
+}
+
+// random ranges plus the edge cases: empty, reversed, single key, prefix, suffix, everything
+std::vector<Range> MakeRanges(std::mt19937& rng, int key_range)
+{
+    std::vector<Range> ranges = {{0, -1}, {key_range, 0}, {-10, -1}, {key_range, key_range + 10},
+                                 {-10, key_range / 3}, {key_range / 2, key_range + 10},
+                                 {-10, key_range + 10}, {key_range / 2, key_range / 2}};
+
+    for (int i = 0; i < 20; ++i)
+    {
+        int lo  = static_cast<int>(rng() % static_cast<unsigned>(key_range));
+        int len = static_cast<int>(rng() % static_cast<unsigned>(key_range / (i % 4 == 0 ? 1 : 20) + 1));
+
+        ranges.push_back({lo, lo + len});
+    }
+
+    return ranges;
+}
+
+// what std::set says [lo, hi] holds, removing it from keys
+std::set<int> TakeRange(std::set<int>& keys, Range range)
+{
+    if (range.lo > range.hi)
+        return {};
+
+    auto first = keys.lower_bound(range.lo);
+    auto last  = keys.upper_bound(range.hi);
+
+    std::set<int> taken(first, last);
+    keys.erase(first, last);
+
+    return taken;
+}
+
+void ExpectSame(const Tree& tree, const std::set<int>& expected)
+{
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_EQ(tree.size(), expected.size());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin()));
+}
+
+constexpr std::size_t SIZES[] = {0, 1, 2, 5, 64, 1000, 20000};
+
+}
+
+TEST(RangeErase, EraseRange)
+{
+    std::mt19937 rng(16);
+
+    for (std::size_t size : SIZES)
+    {
+        int key_range = static_cast<int>(size * 3 + 10);
+
+        for (Range range : MakeRanges(rng, key_range))
+        {
+            std::set<int> expected = RandomSet(rng, size, key_range);
+            Tree          tree(expected.begin(), expected.end());
+
+            std::size_t erased = tree.EraseRange(range.lo, range.hi);
+
+            ASSERT_EQ(erased, TakeRange(expected, range).size()) << "[" << range.lo << ", " << range.hi << "] of " << size;
+            ExpectSame(tree, expected);
+
+            tree.insert(range.lo);
+            expected.insert(range.lo);
+            ExpectSame(tree, expected);
+        }
+    }
+}
+
+TEST(RangeErase, EraseIterators)
+{
+    std::mt19937 rng(17);
+
+    for (std::size_t size : SIZES)
+    {
+        int key_range = static_cast<int>(size * 3 + 10);
+
+        for (Range range : MakeRanges(rng, key_range))
+        {
+            if (range.lo > range.hi)
+                continue;
+
+            std::set<int> expected = RandomSet(rng, size, key_range);
+            Tree          tree(expected.begin(), expected.end());
+
+            Tree::const_iterator first = tree.LowerBound(range.lo);
+            Tree::const_iterator last  = tree.UpperBound(range.hi);
+
+            bool last_is_end = last == tree.end();
+            int  last_key    = last_is_end ? 0 : *last;
+
+            Tree::iterator after = tree.erase(first, last);
+
+            TakeRange(expected, range);
+
+            // the returned iterator is last, still pointing at its key
+            ASSERT_EQ(after == tree.end(), last_is_end);
+            if (!last_is_end)
+            {
+                ASSERT_EQ(*after, last_key);
+            }
+
+            ExpectSame(tree, expected);
+        }
+    }
+}
+
+TEST(RangeErase, ExtractRange)
+{
+    std::mt19937 rng(18);
+
+    for (std::size_t size : SIZES)
+    {
+        int key_range = static_cast<int>(size * 3 + 10);
+
+        for (Range range : MakeRanges(rng, key_range))
+        {
+            std::set<int> expected = RandomSet(rng, size, key_range);
+            Tree          tree(expected.begin(), expected.end());
+
+            Tree          extracted     = tree.ExtractRange(range.lo, range.hi);
+            std::set<int> expected_part = TakeRange(expected, range);
+
+            ExpectSame(tree,      expected);
+            ExpectSame(extracted, expected_part);
+
+            // both trees keep working on their own arenas, and either may be emptied first
+            for (int i = 0; i < 50; ++i)
+            {
+                int key = static_cast<int>(rng() % static_cast<unsigned>(key_range));
+
+                tree.insert(key);
+                expected.insert(key);
+
+                extracted.erase(key);
+                expected_part.erase(key);
+            }
+
+            ExpectSame(tree,      expected);
+            ExpectSame(extracted, expected_part);
+
+            if (size % 2 == 0)
+                extracted.clear();
+            else
+                tree.clear();
+        }
+    }
+}
+
+TEST(RangeErase, ExtractedRangeIsWrittenOnAnotherThread)
+{
+    std::mt19937  rng(20);
+    std::set<int> expected = RandomSet(rng, 40000, 1 << 20);
+    Tree          tree(expected.begin(), expected.end());
+
+    std::vector<Tree>          parts;
+    std::vector<std::set<int>> expected_parts;
+
+    // the source is cut several times, the later parts adopt the chunks of the earlier ones
+    for (int lo = 0; lo < (1 << 20); lo += 1 << 18)
+    {
+        parts.push_back(tree.ExtractRange(lo, lo + (1 << 16)));
+        expected_parts.push_back(TakeRange(expected, {lo, lo + (1 << 16)}));
+    }
+
+    // part i churns keys of [base, base + 5000) on a thread of its own, the source on this one
+    auto churn = [](Tree& target, std::set<int>& model, int base)
+    {
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int key = base; key < base + 5000; ++key)
+            {
+                target.insert(key);
+                model.insert(key);
+            }
+
+            for (int key = base; key < base + 5000; key += 3)
+            {
+                target.erase(key);
+                model.erase(key);
+            }
+        }
+    };
+
+    std::vector<std::thread> writers;
+
+    for (std::size_t i = 0; i < parts.size(); ++i)
+        writers.emplace_back([&, i] { churn(parts[i], expected_parts[i], static_cast<int>(i) << 18); });
+
+    churn(tree, expected, 3 << 16);
+
+    for (std::thread& writer : writers)
+        writer.join();
+
+    ExpectSame(tree, expected);
+
+    for (std::size_t i = 0; i < parts.size(); ++i)
+        ExpectSame(parts[i], expected_parts[i]);
+}
+
+TEST(RangeErase, ErasesUntilEmpty)
+{
+    std::mt19937  rng(19);
+    std::set<int> expected = RandomSet(rng, 30000, 1 << 20);
+    Tree          tree(expected.begin(), expected.end());
+
+    while (!expected.empty())
+    {
+        int lo = static_cast<int>(rng() % (1 << 20));
+        int hi = lo + static_cast<int>(rng() % (1 << 16));
+
+        ASSERT_EQ(tree.EraseRange(lo, hi), TakeRange(expected, {lo, hi}).size());
+        ASSERT_EQ(tree.size(), expected.size());
+
+        if (expected.size() < 100)
+        {
+            ASSERT_EQ(tree.EraseRange(-1, 1 << 20), expected.size());
+            expected.clear();
+        }
+    }
+
+    ExpectSame(tree, expected);
+    EXPECT_TRUE(tree.empty());
+    EXPECT_EQ(tree.begin(), tree.end());
+}
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RedBlackTree/tree.hpp"
+
+// Split, Join and the set operations against std::set and the std::set_* algorithms, from
+// empty operands up to sizes where Union/Intersection/Difference fork into parallel halves,
+// and the trees they return written on separate threads (run under TSan as set_ops_test_tsan).
+
+namespace {
+
+using Tree = Trees::RBT::Tree<int, std::greater<int>>;
+
+std::vector<int> RandomKeys(std::mt19937& rng, std::size_t count, int key_range)
+{
+    std::vector<int> keys(count);
+
+    for (int& key : keys)
+        key = static_cast<int>(rng() % static_cast<unsigned>(key_range));
+
+    return keys;
+}
+
+std::vector<int> Sorted(std::vector<int> keys)
+{
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    return keys;
+}
+
+std::vector<int> Keys(const Tree& tree)
+{
+    return std::vector<int>(tree.begin(), tree.end());
+}
+
+struct Operands
+{
+    std::vector<int> lhs;
+    std::vector<int> rhs;
+};
+
+// sizes from empty to above Tree::PARALLEL_MIN_KEYS (2^14), dense and sparse overlaps
+std::vector<Operands> MakeOperands()
+{
+    std::mt19937          rng(15);
+    std::vector<Operands> cases;
+
+    for (std::size_t lhs_size : {0u, 1u, 7u, 100u, 5000u, 40000u})
+        for (std::size_t rhs_size : {0u, 1u, 13u, 3000u, 50000u})
+            for (int key_range : {100, 100000})
+                cases.push_back({RandomKeys(rng, lhs_size, key_range), RandomKeys(rng, rhs_size, key_range)});
+
+    // identical and disjoint operands
+    std::vector<int> same = RandomKeys(rng, 30000, 1 << 20);
+    cases.push_back({same, same});
+
+    std::vector<int> low(20000), high(20000);
+    for (int i = 0; i < 20000; ++i)
+    {
+        low [i] = i;
+        high[i] = 100000 + i;
+    }
+
+    cases.push_back({low, high});
+    cases.push_back({high, low});
+
+    return cases;
+}
+
+template <typename TreeOp, typename StdOp>
+void CheckSetOperation(TreeOp tree_op, StdOp std_op)
+{
+    for (const Operands& operands : MakeOperands())
+    {
+        std::vector<int> lhs = Sorted(operands.lhs);
+        std::vector<int> rhs = Sorted(operands.rhs);
+
+        std::vector<int> expected;
+        std_op(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), std::back_inserter(expected));
+
+        Tree result = tree_op(Tree(operands.lhs.begin(), operands.lhs.end()), Tree(operands.rhs.begin(), operands.rhs.end()));
+
+        ASSERT_TRUE(result.IsValid()) << lhs.size() << " and " << rhs.size() << " keys";
+        ASSERT_EQ(result.size(), expected.size());
+        ASSERT_EQ(Keys(result), expected);
+
+        // the result is an ordinary tree afterwards
+        result.insert(-1);
+        result.erase(expected.empty() ? 0 : expected[expected.size() / 2]);
+        ASSERT_TRUE(result.IsValid());
+    }
+}
+
+}
+
+TEST(SetOps, Union)
+{
+    CheckSetOperation([](Tree&& lhs, Tree&& rhs) { return Tree::Union(std::move(lhs), std::move(rhs)); },
+                      [](auto... args) { return std::set_union(args...); });
+}
+
+TEST(SetOps, Intersection)
+{
+    CheckSetOperation([](Tree&& lhs, Tree&& rhs) { return Tree::Intersection(std::move(lhs), std::move(rhs)); },
+                      [](auto... args) { return std::set_intersection(args...); });
+}
+
+TEST(SetOps, Difference)
+{
+    CheckSetOperation([](Tree&& lhs, Tree&& rhs) { return Tree::Difference(std::move(lhs), std::move(rhs)); },
+                      [](auto... args) { return std::set_difference(args...); });
+}
+
+TEST(SetOps, SplitAndJoin)
+{
+    std::mt19937 rng(16);
+
+    for (std::size_t size : {0u, 1u, 2u, 10u, 1000u, 30000u})
+    {
+        std::vector<int> keys   = RandomKeys(rng, size, 50000);
+        std::vector<int> sorted = Sorted(keys);
+
+        for (int split_key : {-5, 0, 777, 25000, 49999, 60000})
+        {
+            Tree tree(keys.begin(), keys.end());
+
+            auto [less, rest] = tree.Split(split_key);
+
+            EXPECT_TRUE(tree.empty());
+            ASSERT_TRUE(less.IsValid());
+            ASSERT_TRUE(rest.IsValid());
+
+            auto border = std::lower_bound(sorted.begin(), sorted.end(), split_key);
+
+            ASSERT_EQ(Keys(less), std::vector<int>(sorted.begin(), border));
+            ASSERT_EQ(Keys(rest), std::vector<int>(border, sorted.end()));
+
+            // joining the halves back gives the original tree, with and without a middle key
+            bool has_key = border != sorted.end() && *border == split_key;
+
+            Tree joined = Tree::Join(std::move(less), std::move(rest));
+
+            ASSERT_TRUE(joined.IsValid());
+            ASSERT_EQ(Keys(joined), sorted);
+
+            auto [left, right] = joined.Split(split_key);
+
+            if (has_key)
+                right.erase(split_key);
+
+            Tree with_key = Tree::Join(std::move(left), split_key, std::move(right));
+
+            std::set<int> expected(sorted.begin(), sorted.end());
+            expected.insert(split_key);
+
+            ASSERT_TRUE(with_key.IsValid());
+            ASSERT_EQ(Keys(with_key), std::vector<int>(expected.begin(), expected.end()));
+        }
+    }
+}
+
+TEST(SetOps, JoinTreesOfVeryDifferentHeights)
+{
+    std::vector<int> small = {1, 2, 3};
+    std::vector<int> single = {200000};
+    std::vector<int> large(100000);
+
+    for (int i = 0; i < 100000; ++i)
+        large[i] = 10 + i;
+
+    Tree left_heavy = Tree::Join(Tree(large.begin(), large.end()), Tree(single.begin(), single.end()));
+
+    ASSERT_TRUE(left_heavy.IsValid());
+    EXPECT_EQ(left_heavy.size(), 100001u);
+
+    Tree right_heavy = Tree::Join(Tree(small.begin(), small.end()), 5, Tree(large.begin(), large.end()));
+
+    ASSERT_TRUE(right_heavy.IsValid());
+    EXPECT_EQ(right_heavy.size(), 100004u);
+    EXPECT_EQ(right_heavy.front(), 1);
+    EXPECT_EQ(right_heavy.back(), 100009);
+}
+
+// each returned tree has an arena of its own, so nothing they free or allocate meets
+TEST(SetOps, ResultsAreWrittenOnSeparateThreads)
+{
+    std::mt19937 rng(17);
+
+    std::vector<int> keys = RandomKeys(rng, 20000, 100000);
+
+    // inserts and erases keys of [lo, hi) until the tree holds only the new odd ones
+    auto churn = [](Tree& tree, int lo, int hi)
+    {
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int key = lo; key < hi; ++key)
+                tree.insert(key);
+
+            for (int key = lo; key < hi; key += 2)
+                tree.erase(key);
+        }
+    };
+
+    auto expect_churned = [](const Tree& tree, std::vector<int> kept, int lo, int hi)
+    {
+        kept.erase(std::remove_if(kept.begin(), kept.end(), [&](int key) { return key >= lo && key < hi; }), kept.end());
+
+        for (int key = lo + 1; key < hi; key += 2)
+            kept.push_back(key);
+
+        ASSERT_TRUE(tree.IsValid());
+        ASSERT_EQ(Keys(tree), Sorted(kept));
+    };
+
+    std::vector<int> sorted = Sorted(keys);
+    auto             border = std::lower_bound(sorted.begin(), sorted.end(), 50000);
+
+    Tree tree(keys.begin(), keys.end());
+
+    auto [less, rest] = tree.Split(50000);
+
+    {
+        std::thread less_writer([&] { churn(less, 0, 20000); });
+        std::thread rest_writer([&] { churn(rest, 60000, 80000); });
+
+        // the emptied tree is a third owner of the old arena
+        churn(tree, 200000, 201000);
+
+        less_writer.join();
+        rest_writer.join();
+    }
+
+    expect_churned(less, std::vector<int>(sorted.begin(), border), 0,     20000);
+    expect_churned(rest, std::vector<int>(border, sorted.end()),   60000, 80000);
+    expect_churned(tree, {},                                       200000, 201000);
+
+    // a joined result and the arguments it emptied
+    std::vector<int> less_keys = Keys(less);
+    std::vector<int> rest_keys = Keys(rest);
+
+    Tree joined = Tree::Join(std::move(less), std::move(rest));
+
+    std::vector<int> all_keys = Keys(joined);
+
+    {
+        std::thread joined_writer([&] { churn(joined, 100000, 120000); });
+        std::thread less_writer  ([&] { churn(less,   0,      20000);  });
+
+        churn(rest, 0, 20000);
+
+        joined_writer.join();
+        less_writer.join();
+    }
+
+    expect_churned(joined, all_keys, 100000, 120000);
+    expect_churned(less,   {},       0,      20000);
+    expect_churned(rest,   {},       0,      20000);
+
+    // a union and its emptied operands
+    Tree lhs(less_keys.begin(), less_keys.end());
+    Tree rhs(rest_keys.begin(), rest_keys.end());
+
+    Tree united = Tree::Union(std::move(lhs), std::move(rhs));
+
+    {
+        std::thread united_writer([&] { churn(united, 100000, 120000); });
+        std::thread lhs_writer   ([&] { churn(lhs,    0,      20000);  });
+
+        churn(rhs, 0, 20000);
+
+        united_writer.join();
+        lhs_writer.join();
+    }
+
+    std::vector<int> both = less_keys;
+    both.insert(both.end(), rest_keys.begin(), rest_keys.end());
+
+    expect_churned(united, both, 100000, 120000);
+    expect_churned(lhs,    {},   0,      20000);
+    expect_churned(rhs,    {},   0,      20000);
+}
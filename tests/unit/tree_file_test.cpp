@@ -0,0 +1,104 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RedBlackTree/tree.hpp"
+
+// Tree::Save, Open and Load: a round trip, and the error each failure reports.
+
+namespace {
+
+using Tree = Trees::RBT::Tree<int, std::greater<int>>;
+
+std::string TempPath(const char* name)
+{
+    return ::testing::TempDir() + name + std::to_string(::getpid());
+}
+
+void WriteFile(const std::string& path, const std::string& bytes)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+
+    ASSERT_NE(file, nullptr);
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+}
+
+}
+
+TEST(TreeFile, SaveOpenLoadRoundTrip)
+{
+    std::string path = TempPath("round_trip.tree");
+
+    for (int count : {0, 1, 17, 100000})
+    {
+        std::vector<int> keys;
+        for (int i = 0; i < count; ++i)
+            keys.push_back(i * 3 - 1000);
+
+        Tree tree(keys.begin(), keys.end());
+
+        std::error_code error = std::make_error_code(std::errc::io_error);
+
+        ASSERT_TRUE(tree.Save(path, error)) << error.message();
+        EXPECT_FALSE(error);
+        EXPECT_NE(::access((path + ".tmp").c_str(), F_OK), 0);
+
+        auto mapped = Tree::Open(path, error);
+
+        ASSERT_TRUE(mapped) << error.message();
+        EXPECT_FALSE(error);
+        EXPECT_TRUE(std::equal(mapped->begin(), mapped->end(), keys.begin(), keys.end()));
+
+        auto loaded = Tree::Load(path, error);
+
+        ASSERT_TRUE(loaded) << error.message();
+        EXPECT_TRUE(loaded->IsValid());
+        EXPECT_TRUE(std::equal(loaded->begin(), loaded->end(), keys.begin(), keys.end()));
+    }
+
+    ::unlink(path.c_str());
+}
+
+TEST(TreeFile, ReportsWhyItFailed)
+{
+    std::error_code error;
+
+    // I/O errors come back as the errno of the failed call
+    EXPECT_FALSE(Tree::Open(TempPath("missing.tree"), error));
+    EXPECT_EQ(error, std::errc::no_such_file_or_directory);
+
+    Tree tree;
+    tree.insert(1);
+
+    EXPECT_FALSE(tree.Save(TempPath("no/such/dir.tree"), error));
+    EXPECT_EQ(error, std::errc::no_such_file_or_directory);
+
+    // a readable file of another format, key size or length
+    std::string path = TempPath("other.tree");
+
+    for (const std::string& bytes : {std::string("short"), std::string(4096, 'x')})
+    {
+        WriteFile(path, bytes);
+
+        error.clear();
+        EXPECT_FALSE(Tree::Load(path, error));
+        EXPECT_EQ(error, Trees::RBT::FileIO::Error::WRONG_FORMAT);
+        EXPECT_FALSE(error.message().empty());
+    }
+
+    ASSERT_TRUE(tree.Save(path, error));
+
+    error.clear();
+    EXPECT_FALSE((Trees::RBT::Tree<long long, std::greater<long long>>::Open(path, error)));
+    EXPECT_EQ(error, Trees::RBT::FileIO::Error::WRONG_FORMAT);
+
+    ::unlink(path.c_str());
+}